@@ -0,0 +1,202 @@
+// Formats synthetic BBO records to csv the way the exporter used to (ostringstream, snprintf timestamp, double
+// prices, bimap lookup per record) and through DataExporter, checks both files are identical and reports the
+// time per record.
+//
+// Usage: BBOFormatBench [records]    (default 1000000, writes and removes two csv files in ..)
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Config.hpp"
+#include "DataExporter.hpp"
+
+namespace
+{
+    // Trade date of the records, far from any capture so that a real bbo-<date>.csv is never overwritten
+    constexpr std::time_t Midnight = 946'857'600 + 6 * 3600; // 2000-01-03 00:00 CT
+    constexpr const char* Date = "2000-01-03";
+
+    struct SyntheticRecord
+    {
+        uint32_t timeRef;
+        uint32_t timeOffset;
+        uint64_t pktSeqNum;
+        uint64_t msgSeqNum;
+        char msgType;
+        uint32_t symbol;            // Index in the symbols below
+        Order::Price bidPrice;
+        uint32_t bidQuantity;
+        Order::Price askPrice;
+        uint32_t askQuantity;
+        uint8_t tradingStatus;
+    };
+
+    // Deterministic stream of records: a few thousand per second of exchange time, prices below 10000.00
+    // where "%g" still prints every digit
+    std::vector<SyntheticRecord> make_records(std::size_t count, std::size_t symbols)
+    {
+        std::vector<SyntheticRecord> records;
+        records.reserve(count);
+
+        uint64_t state = 0x9E3779B97F4A7C15ull;
+        auto next = [&state](uint32_t bound)
+        {
+            state = state * 6364136223846793005ull + 1442695040888963407ull;
+            return static_cast<uint32_t>((state >> 33) % bound);
+        };
+
+        uint32_t timeRef = 8 * 3600;
+        uint32_t timeOffset = 0;
+        uint64_t msgSeqNum = 0;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            timeOffset += next(400'000);
+            if (timeOffset >= 1'000'000'000)
+            {
+                timeOffset -= 1'000'000'000;
+                ++timeRef;
+            }
+            msgSeqNum += 1 + next(3);
+
+            Order::Price mid = 1500 + next(2000);
+            records.push_back({timeRef, timeOffset, msgSeqNum / 4, msgSeqNum, "ADMRE"[next(5)], next(static_cast<uint32_t>(symbols)),
+                               mid - 1 - next(5), 1 + next(500), next(10) == 0 ? 0 : mid + 1 + next(5), 1 + next(500), 'T'});
+        }
+        return records;
+    }
+
+    // The exporter before the to_chars rewrite: whole timestamp through snprintf, prices as doubles through an
+    // ostream, readable symbol from the bimap, everything buffered and written at the end
+    void format_baseline(const std::vector<SyntheticRecord>& records, const std::vector<Symbol>& symbols,
+                         const DataExporter::SymbolToReadableBimap& readable, const std::string& filename)
+    {
+        std::ostringstream buffer;
+        char time[36];
+        for (const SyntheticRecord& record : records)
+        {
+            int hours = record.timeRef / 3600;
+            int minutes = (record.timeRef % 3600) / 60;
+            int seconds = record.timeRef % 60;
+            std::snprintf(time, sizeof(time), "%s %02d:%02d:%02d.%09u", Date, hours, minutes, seconds, record.timeOffset);
+
+            buffer << time << ','
+                   << record.pktSeqNum << ','
+                   << record.msgSeqNum << ','
+                   << record.msgType << ','
+                   << readable.left.at(symbols[record.symbol]) << ','
+                   << record.bidPrice * 10e-3 << ','
+                   << record.bidQuantity << ','
+                   << record.askPrice * 10e-3 << ','
+                   << record.askQuantity << ','
+                   << record.tradingStatus << '\n';
+        }
+
+        std::ofstream outfile(filename, std::ios::out);
+        if (!outfile.is_open())
+            throw std::ios_base::failure("Failed to open file: " + filename);
+        outfile << "Time,PktSeqNum,MsgSeqNum,MsgType,Symbol,BidPrice,BidQuantity,AskPrice,AskQuantity,TradingStatus\n";
+        outfile << buffer.str();
+    }
+
+    // The exporter as the books drive it: message infos, then one store_BBO_records per record
+    void format_exporter(const std::vector<SyntheticRecord>& records, const std::vector<Symbol>& symbols, DataExporter& exporter)
+    {
+        std::vector<uint32_t> bboSymbols;
+        for (const Symbol& symbol : symbols)
+            bboSymbols.push_back(exporter.bbo_symbol(symbol));
+
+        exporter.set_date(Midnight);
+        uint32_t timeRef = UINT32_MAX;
+        for (const SyntheticRecord& record : records)
+        {
+            if (record.timeRef != timeRef)
+            {
+                timeRef = record.timeRef;
+                exporter.set_time_ref(timeRef);
+            }
+            exporter.set_message_infos(record.timeOffset, record.pktSeqNum, record.msgSeqNum);
+            exporter.store_BBO_records(record.msgType, bboSymbols[record.symbol], record.bidPrice, record.bidQuantity,
+                                       record.askPrice, record.askQuantity, record.tradingStatus);
+        }
+        exporter.finish();
+    }
+
+    bool same_content(const std::string& a, const std::string& b)
+    {
+        std::ifstream fa(a, std::ios::binary);
+        std::ifstream fb(b, std::ios::binary);
+        return std::equal(std::istreambuf_iterator<char>(fa), std::istreambuf_iterator<char>(),
+                          std::istreambuf_iterator<char>(fb), std::istreambuf_iterator<char>());
+    }
+
+    template<typename F>
+    double time_ms(F&& f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t count = argc > 1 ? std::stoull(argv[1]) : 1'000'000;
+
+    // The exporter reads its format (csv) from the options
+    std::vector<std::string> args{"BBOFormatBench", "--bbo", "bench.pcap"};
+    std::vector<char*> cargs;
+    for (std::string& arg : args)
+        cargs.push_back(arg.data());
+    if (int error_code = handle_options(static_cast<int>(cargs.size()), cargs.data()); error_code != 0)
+        return error_code;
+
+    try
+    {
+        DataExporter exporter{};
+        DataExporter::SymbolToReadableBimap readable;
+        std::vector<Symbol> symbols;
+        for (const char* name : {"VX    ", "VX01  ", "VX02  ", "VX03  ", "VX04  ", "VXT   ", "VXM   ", "VXTM  "})
+        {
+            // Readable symbols come from the instrument definitions, as in the feed
+            FuturesInstrumentDefinition definition{};
+            std::memcpy(definition.Symbol, name, 6);
+            std::memcpy(definition.ReportSymbol, name, 6);
+            definition.ExpirationDate = 20241016;
+            symbols.emplace_back(name);
+            exporter.symbol_tostring(symbols.back(), definition, nullptr);
+            readable.insert({symbols.back(), exporter.get_human_readable_symbol(symbols.back())});
+        }
+
+        std::vector<SyntheticRecord> records = make_records(count, symbols.size());
+        std::string baselineFile = std::string("../bbo-") + Date + ".baseline.csv";
+        std::string exporterFile = std::string("../bbo-") + Date + ".csv";
+
+        double baselineMs = time_ms([&] { format_baseline(records, symbols, readable, baselineFile); });
+        double exporterMs = time_ms([&] { format_exporter(records, symbols, exporter); });
+
+        bool identical = same_content(baselineFile, exporterFile);
+        std::remove(baselineFile.c_str());
+        std::remove(exporterFile.c_str());
+
+        std::cout << count << " records\n";
+        std::cout << "baseline:     " << baselineMs << " ms, " << baselineMs * 1e6 / count << " ns per record\n";
+        std::cout << "DataExporter: " << exporterMs << " ms, " << exporterMs * 1e6 / count << " ns per record\n";
+        std::cout << "speedup:      " << baselineMs / exporterMs << "x, output " << (identical ? "identical" : "DIFFERS") << "\n";
+        return identical ? 0 : 1;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+}
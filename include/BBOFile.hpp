@@ -0,0 +1,125 @@
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "PcapReader.hpp"
+
+// Binary BBO file (--bboFormat=binary), laid out so that a reader can map it and use the records in place:
+//
+//   BBOFileHeader                      64 bytes
+//   BBORecord[recordCount]             64 bytes each, in exchange time order
+//   BBOSymbolEntry[symbolCount]        symbol dictionary
+//   char names[]                       readable symbols referenced by the dictionary
+//
+// Records refer to their symbol by its index in the dictionary. The writer only knows the dictionary once
+// the day is over, so it follows the records and the header (written last) gives its offset.
+// Integers are little-endian.
+
+struct BBOFileHeader
+{
+    static constexpr char Magic[8] = {'M', 'B', 'O', 'B', 'B', 'O', '\0', '\0'};
+    static constexpr uint32_t CurrentVersion = 2;   // 2: epoch timestamps, 64 bit sequence numbers
+
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;        // sizeof(BBORecord) of the writer
+    uint64_t recordCount;
+    uint64_t symbolOffset;      // Byte offset of the dictionary
+    uint32_t symbolCount;
+    uint32_t reserved0;
+    uint64_t namesOffset;       // Byte offset of the names
+    uint64_t namesSize;
+    uint64_t reserved1;
+};
+static_assert(sizeof(BBOFileHeader) == 64, "BBOFileHeader must be 64 bytes");
+
+struct BBORecord
+{
+    uint64_t timestamp;         // Exchange time in nanoseconds since the Epoch, the clock of the L3 events
+    int64_t bidPrice;           // Feed units (1/100), 0 when the side is empty
+    int64_t askPrice;
+    uint64_t pktSeqNum;
+    uint64_t msgSeqNum;
+    uint32_t bidQuantity;
+    uint32_t askQuantity;
+    uint32_t symbol;            // Index in the symbol dictionary
+    int32_t utcOffset;          // Seconds from UTC to the exchange wall clock (the Time column of the csv)
+    char msgType;               // Message that changed the BBO: A, D, M, R or E
+    uint8_t tradingStatus;
+    uint16_t reserved;
+    uint32_t reserved1;
+};
+static_assert(sizeof(BBORecord) == 64, "BBORecord must be 64 bytes");
+
+// Exchange wall clock time of a record in nanoseconds, as the Time column of the csv shows it
+inline uint64_t bbo_local_time(const BBORecord& record) noexcept
+{
+    return record.timestamp + static_cast<uint64_t>(int64_t{record.utcOffset} * 1'000'000'000);
+}
+
+struct BBOSymbolEntry
+{
+    uint8_t symbol[6];          // Feed symbol (see Symbol)
+    uint16_t nameSize;
+    uint32_t nameOffset;        // Offset of the readable symbol in the names
+};
+static_assert(sizeof(BBOSymbolEntry) == 12, "BBOSymbolEntry must be 12 bytes");
+
+// Prices are in 1/100 units: renders price / 100 without trailing zeros, as "%g" did for the prices
+// of the feed (exactly, where "%g" would round past 6 significant digits)
+inline char* bbo_price_to_chars(char* first, char* last, int64_t price) noexcept
+{
+    if (price < 0)
+    {
+        *first++ = '-';
+        price = -price;
+    }
+
+    first = std::to_chars(first, last, price / 100).ptr;
+    if (int cents = static_cast<int>(price % 100); cents != 0)
+    {
+        *first++ = '.';
+        *first++ = static_cast<char>('0' + cents / 10);
+        if (cents % 10 != 0)
+            *first++ = static_cast<char>('0' + cents % 10);
+    }
+    return first;
+}
+
+// Memory-mapped binary BBO file: records are read in place, without parsing or copying
+class BBOReader
+{
+public:
+    // Throws std::runtime_error if the file is not a complete binary BBO file of a supported version
+    explicit BBOReader(const std::string& filename);
+    BBOReader(const BBOReader&) = delete;
+    BBOReader& operator=(const BBOReader&) = delete;
+
+    std::span<const BBORecord> records() const noexcept;
+    std::size_t size() const noexcept;
+    const BBORecord& operator[](std::size_t i) const noexcept;
+
+    std::size_t symbol_count() const noexcept;
+    std::string_view symbol_name(uint32_t symbol) const noexcept;
+    // Dictionary index of a readable symbol, linear in the number of symbols
+    std::optional<uint32_t> find_symbol(std::string_view name) const noexcept;
+
+    // Index of the first record at or after timestamp (nanoseconds since the Epoch, binary search), size() if there is none
+    std::size_t lower_bound(uint64_t timestamp) const noexcept;
+
+    // Writes the records as the csv of --bboFormat=csv would have (--dumpBBO)
+    void write_csv(std::ostream& os) const;
+
+private:
+    MappedFile m_file;
+    std::span<const BBORecord> m_records;
+    std::span<const BBOSymbolEntry> m_symbols;
+    std::string_view m_names;
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <utility>
+
+// Compile-time behaviour of the order book mutations (see OrderBook). The parser picks the specialization
+// once from the options, so a disabled feature costs no instruction per message.
+template<bool TrackBBO_, bool CheckIntegrity_, bool ConflateBBO_>
+struct BookPolicy
+{
+    // Export the BBO when a mutation reaching the top of book changed it (--bbo)
+    static constexpr bool TrackBBO = TrackBBO_;
+    // Executions must fill the front of their queue and never exceed the remaining quantity (off with --noChecks)
+    static constexpr bool CheckIntegrity = CheckIntegrity_;
+    // Hold BBO updates inside a TransactionBegin/TransactionEnd block and export one per book at its end (--conflate)
+    static constexpr bool ConflateBBO = TrackBBO_ && ConflateBBO_;
+
+    // The specialization with_book_policy hands out: conflating without tracking is not tracking
+    using Canonical = BookPolicy<TrackBBO_, CheckIntegrity_, ConflateBBO>;
+};
+
+// Calls f.template operator()<Policy>() with the BookPolicy matching the runtime flags, given in the order
+// of the BookPolicy parameters
+template<bool... Flags, typename F>
+decltype(auto) with_book_policy(F&& f)
+{
+    return std::forward<F>(f).template operator()<typename BookPolicy<Flags...>::Canonical>();
+}
+
+template<bool... Flags, typename F, typename... Rest>
+decltype(auto) with_book_policy(F&& f, bool flag, Rest... rest)
+{
+    if (flag)
+        return with_book_policy<Flags..., true>(std::forward<F>(f), rest...);
+    return with_book_policy<Flags..., false>(std::forward<F>(f), rest...);
+}
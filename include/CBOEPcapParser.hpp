@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <cstring>
 #include <fstream>
 #include <iomanip>
@@ -9,13 +10,22 @@
 #include <unordered_map>
 #include <stdexcept>
 #include <chrono>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
 
 #include "cfepitch.h"
 #include "DataExporter.hpp"
+#include "EventLog.hpp"
+#include "MessageDispatch.hpp"
 #include "MessageInfo.hpp"
 #include "OrderBookManager.hpp"
 #include "OrderStore.hpp"
 #include "OrderBook.hpp"
+#include "OrderRouter.hpp"
+#include "PcapReader.hpp"
+#include "SpscRing.hpp"
 #include "StopWatch.hpp"
 
 // Global variables
@@ -23,33 +33,131 @@ class CBOEPcapParser
 {
   public:
     explicit CBOEPcapParser(const std::string& filename, std::size_t id);
+    // Parse only the records of the given day range (always read through the mmap reader)
+    explicit CBOEPcapParser(const std::string& filename, std::size_t id, DayRange range);
     CBOEPcapParser(const CBOEPcapParser& other) = delete;
     void operator=(const CBOEPcapParser& other) = delete;
 
     void start(); // Start processing the pcap file
     void messages_summary();
+    // --singlePass: checks the gaps, counts the messages, splits the file into days and builds their books from
+    // a single walk over it, the days one after the other. They are numbered from firstDay, returns their count.
+    std::size_t single_pass(std::size_t firstDay);
 
   private:
-    void process_message(uint64_t pktSeqNum, uint64_t msgSeqNum, const u_char *message, int msg_type); // Process a single message
-    void process_packet(const u_char *packet) noexcept; // Process a single packet from a PCAP file
-    void gap_helper(const u_char *packet) noexcept;
-    void messages_summary_helper(const u_char *packet) noexcept;
+    // Event handed from the decode stage to the book stage (--pipeline)
+    struct PipelineEvent
+    {
+        L3Event event;
+        std::unique_ptr<u_char[]> definition; // Copy of the FuturesInstrumentDefinition of Instrument events
+    };
+    // --shards: a share of the books with the orders, exporter and thread building them. The exporter forwards
+    // its BBO records to the export stage of the day's DataExporter, which merges the shards.
+    struct BookShard
+    {
+        explicit BookShard(std::size_t ringSize);
+
+        OrderStore store;
+        DataExporter exporter;
+        OrderBookManager obm;
+        SpscRing<PipelineEvent> events;     // Decode stage -> this shard
+        std::thread thread;
+        std::exception_ptr error;
+        uint64_t eventCount;
+        uint64_t busyNs;                    // Applying events, the rest of the stage is spent waiting for them
+    };
+    // Sinks of the MessageDispatcher walking the capture (see MessageDispatch.hpp)
+    template<typename Policy>
+    class BookBuilder;                      // Order books of the day
+    class EventLogRecorder;                 // --eventLog written as the capture is parsed
+    template<typename Emit>
+    class EventDecoder;                     // Decode stage of --pipeline and --shards
+    class GapChecker;                       // --gaps
+    class MessageCounter;                   // --msgSummary
+    template<typename Policy>
+    class DaySplitter;                      // --singlePass days, each built by a parser of its own
+
+  private:
+    // Order book behaviour is a compile-time BookPolicy, selected once in start()
+    template<typename Policy>
+    void parse();
+    // Rebuilds the day from its event log instead of the capture (--eventLog)
+    template<typename Policy>
+    void replay(const EventLogReader& log);
+    // --pipeline: packets are decoded into L3Events on a thread of their own, which feeds the books on this
+    // one through an SpscRing, while the BBO records are formatted by the export stage of the DataExporter
+    template<typename Policy>
+    void pipeline();
+    // --shards: the decode stage deals the events out to shards by book, each building its books on a thread
+    // of its own, and the export stage merges their BBO records back into feed order
+    template<typename Policy>
+    void sharded(std::size_t shardCount);
+    // Decode stage: writes the event log if it is open and stamps event for the book stage
+    PipelineEvent stage_event(L3Event event, EventClock& clock, uint64_t pktSeqNum, uint64_t msgSeqNum, uint32_t timeOffset,
+                              const u_char* definition, std::size_t size);
+    // Applies a decoded event to the books of obm, as the BookBuilder does with the message it came from.
+    // definition is the FuturesInstrumentDefinition of Instrument events.
+    template<typename Policy>
+    static void apply_event(const L3Event& e, EventClock& clock, const u_char* definition, OrderBookManager& obm, DataExporter& dataExporter);
+    // FuturesInstrumentDefinition: creates the book and its readable symbol, returns the book index
+    static Order::BookIndex define_instrument(const u_char* message, OrderBookManager& obm, DataExporter& dataExporter);
+    // --singlePass walk: the day splitter and the gaps and message counters share one MessageDispatcher
+    template<typename Policy>
+    std::size_t fused_pass(std::size_t firstDay);
+    // Prints the --gaps and --msgSummary reports of the messages seen so far, then resets them
+    void print_summary();
+    // Prints the --showOB book if the exchange time is the requested one
+    void show_orderbook();
+    // Warns about the messages a MessageDispatcher skipped (unknown or truncated types)
+    void report_skipped(const std::array<uint64_t, 256>& skipped) const;
+    // Calls callback(packet) for every packet of the file, through libpcap or the mmap reader (--mmap)
+    template<typename Callback>
+    void for_each_packet(Callback&& callback);
 
   private:
     std::string m_pcapFilename;         // Input pcap file
     std::size_t m_id;
+    std::optional<DayRange> m_range;    // Restrict parsing to one day of the file
     MessageInfo m_messageInfo;          // Messages information
     OrderStore m_orderstore;            // Order store
     DataExporter m_dataExporter;        // Data exporter
     OrderBookManager m_obm;             // Order book manager
+    EventLogWriter m_eventLog;          // Open while a day is parsed with --eventLog and has no usable log
+    uint64_t m_replayedEvents;
+    std::unique_ptr<SpscRing<PipelineEvent>> m_eventRing;              // Decode stage -> book stage
+    uint64_t m_decodeNs;                // Lifetimes of the decode and book stages
+    uint64_t m_bookNs;
+    std::vector<std::unique_ptr<BookShard>> m_shards;                  // --shards, kept for the --time report
+};
+
+// Time window [begin, end) to cut out of a capture, in nanoseconds since the Epoch
+struct SliceRange
+{
+    enum class Clock
+    {
+        Pcap,       // Capture timestamp of the pcap record
+        Exchange    // PITCH exchange time (Time/TimeReference seconds + TimeOffset of the packet's first message)
+    };
+
+    uint64_t begin;
+    uint64_t end;
+    Clock clock;
+    std::string output_filename;
 };
 
 class PcapSlicer
 {
   public:
     PcapSlicer(const std::string& filename);
-    std::string slice_pcap(const std::string& begin_time, const std::string& end_time, const std::string& output_filename = "output.pcap");
-    void daily_slice();
+    // begin_time/end_time in ISO 8601 'YYYY-MM-DDTHH:MM:SS' (local time for the pcap clock, like editcap)
+    std::string slice_pcap(const std::string& begin_time, const std::string& end_time, const std::string& output_filename = "output.pcap",
+                           SliceRange::Clock clock = SliceRange::Clock::Pcap);
+    // Cut every range in a single pass over the input, returns the absolute paths of the output files
+    std::vector<std::string> slice_pcap(const std::vector<SliceRange>& ranges);
+    // Writes each day to ../day<firstDay + n>.pcap, returns the number of days written
+    std::size_t daily_slice(std::size_t firstDay = 1);
+    // Header-only pass recording where HdrSequence resets, without writing any file
+    std::vector<DayRange> daily_scan();
 
   private:
     std::string m_pcapFilename;
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <thread>
+
+// Output file written in large chunks by a background thread. Writers format into one fixed-size buffer
+// (through a std::ostream on top of it or directly) while the other one is being written, so memory stays
+// at two chunks however much is written and the writer only waits when the disk is slower than it.
+class ChunkWriter : public std::streambuf
+{
+public:
+    static constexpr std::size_t DefaultChunkSize = std::size_t{1} << 20;
+
+public:
+    explicit ChunkWriter(std::size_t chunkSize = DefaultChunkSize);
+    ChunkWriter(const ChunkWriter&) = delete;
+    ChunkWriter& operator=(const ChunkWriter&) = delete;
+    ChunkWriter(ChunkWriter&&) = delete;
+    ChunkWriter& operator=(ChunkWriter&&) = delete;
+    ~ChunkWriter() noexcept override; // Closes the file, write errors are lost: call close() to see them
+
+    // Truncates or creates the file and starts the writer thread, throws std::ios_base::failure
+    void open(const std::string& filename);
+    bool is_open() const noexcept;
+    // Writes what is left and waits for the writer thread, throws std::ios_base::failure if any write failed
+    void close();
+
+protected:
+    int_type overflow(int_type ch) override;
+
+private:
+    // Hands the active buffer to the writer thread once the other one is free, then switches to it
+    bool submit();
+    void run();
+
+private:
+    std::size_t m_chunkSize;
+    std::unique_ptr<char[]> m_buffers[2];
+    int m_active;                       // Buffer being filled
+    int m_fd;
+    std::string m_filename;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    const char* m_inFlight;             // Chunk handed to the writer thread, nullptr when it is idle
+    std::size_t m_inFlightSize;
+    bool m_closing;
+    int m_error;                        // errno of the first failed write, 0 if none
+};
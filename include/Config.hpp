@@ -2,10 +2,19 @@
 
 #include <bitset>
 #include <iostream>
+#include <optional>
 #include <string>
 #include <vector>
 #include "cxxopts.hpp"
 
+// Format of the BBO files (--bboFormat)
+enum class BBOFormat
+{
+    CSV,
+    Binary,  // Fixed-width records, see BBOFile.hpp
+    Parquet  // Columnar, see ParquetBBOWriter.hpp (builds with MBO_WITH_PARQUET only)
+};
+
 class Config 
 {
 public:
@@ -21,7 +30,8 @@ public:
 
     void initialize(const cxxopts::ParseResult& result) 
     {
-        m_inputFile  = result["input"].as<std::string>();
+        m_inputFiles = result["input"].as<std::vector<std::string>>();
+        m_inputFile  = m_inputFiles.front();
         if (result.count("showOB"))
             m_orderbook  = result["showOB"].as<std::vector<std::string>>();
         m_gaps       = m_options[0] = result["gaps"].as<bool>();
@@ -30,9 +40,25 @@ public:
         m_bbo        = m_options[3] = result["bbo"].as<bool>();
         m_arbitrage  = m_options[4] = result["arbitrage"].as<bool>();
         m_showOB     = m_options[5] = !m_orderbook.empty();
+        m_mmap       = result["mmap"].as<bool>();
+        m_scan       = result["scan"].as<bool>();
+        m_index      = result["index"].as<bool>();
+        m_threads    = result["threads"].as<std::size_t>();
+        m_flatLadder = result["ladder"].as<std::string>() == "flat";
+        m_orderCapacity = result["orderCapacity"].as<std::size_t>();
+        m_noChecks   = result["noChecks"].as<bool>();
+        m_conflate   = result["conflate"].as<bool>();
+        m_bboFormat  = parse_bbo_format(result["bboFormat"].as<std::string>()).value_or(BBOFormat::CSV);
+        m_dumpBBO    = result["dumpBBO"].as<bool>();
+        m_eventLog   = result["eventLog"].as<bool>();
+        m_pipeline   = result["pipeline"].as<bool>();
+        m_ringSize   = result["ringSize"].as<std::size_t>();
+        m_shards     = result["shards"].as<std::size_t>();
+        m_singlePass = result["singlePass"].as<bool>();
     }
 
     const std::string& getInputFile() const noexcept { return m_inputFile; }
+    const std::vector<std::string>& getInputFiles() const noexcept { return m_inputFiles; }
     const std::vector<std::string>& orderbook() const noexcept { return m_orderbook; }
     bool gaps() const noexcept { return m_gaps; }
     bool msgSummary() const noexcept { return m_msgSummary;}
@@ -40,6 +66,35 @@ public:
     bool bbo() const noexcept { return m_bbo; }
     bool arbitrage() const noexcept { return m_arbitrage; }
     bool showOB() const noexcept { return m_showOB; }
+    bool mmap() const noexcept { return m_mmap; }
+    bool scan() const noexcept { return m_scan; }
+    bool index() const noexcept { return m_index; }
+    std::size_t threads() const noexcept { return m_threads; }
+    bool flatLadder() const noexcept { return m_flatLadder; }
+    std::size_t orderCapacity() const noexcept { return m_orderCapacity; }
+    bool noChecks() const noexcept { return m_noChecks; }
+    bool conflate() const noexcept { return m_conflate; }
+    BBOFormat bboFormat() const noexcept { return m_bboFormat; }
+    bool dumpBBO() const noexcept { return m_dumpBBO; }
+    bool eventLog() const noexcept { return m_eventLog; }
+    bool pipeline() const noexcept { return m_pipeline; }
+    std::size_t ringSize() const noexcept { return m_ringSize; }
+    std::size_t shards() const noexcept { return m_shards; }
+    bool singlePass() const noexcept { return m_singlePass; }
+    // Formats this build can write, std::nullopt for any other name
+    static std::optional<BBOFormat> parse_bbo_format(const std::string& name) noexcept
+    {
+        if (name == "csv")
+            return BBOFormat::CSV;
+        if (name == "binary")
+            return BBOFormat::Binary;
+#ifdef MBO_WITH_PARQUET
+        if (name == "parquet")
+            return BBOFormat::Parquet;
+#endif
+        return std::nullopt;
+    }
+
     bool gaps_or_msgSum_excl() const noexcept
     {
         if (m_gaps || m_msgSummary)
@@ -58,11 +113,12 @@ public:
     }
 
 private:
-    Config() : m_inputFile{}, m_orderbook{}, m_options{}, m_gaps{false}, 
-        m_msgSummary{false}, m_time{false}, m_bbo{false}, m_arbitrage{false}, m_showOB{false} {}
+    Config() : m_inputFile{}, m_inputFiles{}, m_orderbook{}, m_options{}, m_gaps{false}, 
+        m_msgSummary{false}, m_time{false}, m_bbo{false}, m_arbitrage{false}, m_showOB{false}, m_mmap{false}, m_scan{false}, m_index{false}, m_threads{0}, m_flatLadder{false}, m_orderCapacity{0}, m_noChecks{false}, m_conflate{false}, m_bboFormat{BBOFormat::CSV}, m_dumpBBO{false}, m_eventLog{false}, m_pipeline{false}, m_ringSize{0}, m_shards{1}, m_singlePass{false} {}
 
 private:
     std::string m_inputFile;
+    std::vector<std::string> m_inputFiles;
     std::vector<std::string> m_orderbook;
     std::bitset<6> m_options;
     bool m_gaps;
@@ -71,6 +127,21 @@ private:
     bool m_bbo;
     bool m_arbitrage;
     bool m_showOB;
+    bool m_mmap;      // Read pcap files through the zero-copy mmap reader instead of libpcap
+    bool m_scan;      // Split days by byte offsets in the input file instead of writing dayN.pcap files
+    bool m_index;     // Use (or build) the <input>.idx sidecar packet index, implies in-place day ranges
+    std::size_t m_threads; // Worker threads used to parse days, 0 = hardware concurrency
+    bool m_flatLadder; // Order books store price levels in a tick-indexed array instead of a std::map
+    std::size_t m_orderCapacity; // Live orders the order store of each day is pre-sized for
+    bool m_noChecks;  // Order books skip their integrity checks (see BookPolicy)
+    bool m_conflate;  // One BBO record per book and transaction block instead of one per message
+    BBOFormat m_bboFormat;
+    bool m_dumpBBO;   // The inputs are binary BBO files to print as csv, nothing is parsed
+    bool m_eventLog;  // Replay days from their <capture>.<begin>-<end>.l3 event log, written on the first run (implies --scan)
+    bool m_pipeline;  // Decode, build the books and format the BBO of a day on three threads
+    std::size_t m_ringSize; // Capacity of the rings between the --pipeline stages (rounded up to a power of two)
+    std::size_t m_shards;   // Threads building the books of a day, each with a share of the symbols (> 1 implies --pipeline)
+    bool m_singlePass;      // Gaps, message summary, day splitting and books from a single read of each input
 };
 
 inline int handle_options(int argc, char* argv[])
@@ -78,20 +149,35 @@ inline int handle_options(int argc, char* argv[])
     // Define and parse command-line options
         cxxopts::Options options("CBOEParser", "PCAP File Parser with Various Functionalities");
         options.add_options()
-            ("input", "Input pcap file path", cxxopts::value<std::string>())
+            ("input", "Input pcap file path(s)", cxxopts::value<std::vector<std::string>>())
             ("bbo", "Enable BBO writer", cxxopts::value<bool>()->default_value("false"))
             ("gaps", "Enable Gaps Checker", cxxopts::value<bool>()->default_value("false"))
             ("msgSummary", "Enable Message Summary", cxxopts::value<bool>()->default_value("false"))
             ("arbitrage", "Enable the arbitrage finder", cxxopts::value<bool>()->default_value("false"))
             ("showOB", "Display an orderbook at a specific time", cxxopts::value<std::vector<std::string>>())
+            ("mmap", "Read pcap files with the memory-mapped reader instead of libpcap", cxxopts::value<bool>()->default_value("false"))
+            ("scan", "Split days in memory (byte offsets) instead of writing day slices to disk", cxxopts::value<bool>()->default_value("false"))
+            ("index", "Use or build a sidecar <input>.idx packet index for instant day splitting and --showOB seeks", cxxopts::value<bool>()->default_value("false"))
+            ("threads", "Number of worker threads parsing days (default: hardware concurrency)", cxxopts::value<std::size_t>()->default_value("0"))
+            ("ladder", "Price level storage of the order books: map or flat (tick-indexed array)", cxxopts::value<std::string>()->default_value("map"))
+            ("orderCapacity", "Peak number of live orders per day to pre-size the order store for", cxxopts::value<std::size_t>()->default_value("262144"))
+            ("conflate", "With --bbo, write one BBO record per symbol at the end of each transaction block", cxxopts::value<bool>()->default_value("false"))
+            ("bboFormat", "BBO file format: csv, binary (fixed-width records, see --dumpBBO) or parquet (builds with MBO_WITH_PARQUET)", cxxopts::value<std::string>()->default_value("csv"))
+            ("dumpBBO", "Print the binary BBO files given as input as csv", cxxopts::value<bool>()->default_value("false"))
+            ("eventLog", "Write each day's decoded order events to a <capture>.<begin>-<end>.l3 log and replay it on later runs (implies --scan)", cxxopts::value<bool>()->default_value("false"))
+            ("pipeline", "Decode packets, build the books and format BBO records of each day on three threads", cxxopts::value<bool>()->default_value("false"))
+            ("ringSize", "Capacity of the rings between the --pipeline stages, in events (rounded up to a power of two)", cxxopts::value<std::size_t>()->default_value("16384"))
+            ("shards", "Build the books of each day on this many threads, each owning a share of the symbols (implies --pipeline)", cxxopts::value<std::size_t>()->default_value("1"))
+            ("singlePass", "Check gaps, count messages, split days and build their books in one pass over each input, days one after the other (not with --pipeline, --shards, --eventLog or --index)", cxxopts::value<bool>()->default_value("false"))
+            ("noChecks", "Skip the order book integrity checks (execution queue priority, overfills)", cxxopts::value<bool>()->default_value("false"))
             ("t,time", "Display time", cxxopts::value<bool>()->default_value("false"))
             ("h,help", "Print usage");
 
         options.parse_positional({"input"});
-        options.positional_help("input_file");
+        options.positional_help("input_file...");
 
         // Customize help message to include positional arguments
-        std::string usage = "Usage:\n  CBOEPcapParser [options] <input_file.pcap>";
+        std::string usage = "Usage:\n  CBOEPcapParser [options] <input_file.pcap> [<input_file.pcap>...]";
         std::string example = "Example:\n  CBOEPcapParser --msgSummary --gaps --bbo ../path/to/file.pcap";
 
         auto result = options.parse(argc, argv);
@@ -124,6 +210,27 @@ inline int handle_options(int argc, char* argv[])
             }
         }
 
+        if (auto ladder = result["ladder"].as<std::string>(); ladder != "map" && ladder != "flat")
+        {
+            std::cerr << "Error: --ladder must be either map or flat, got " << ladder << "\n";
+            return 4;
+        }
+
+        if (auto format = result["bboFormat"].as<std::string>(); !Config::parse_bbo_format(format))
+        {
+            if (format == "parquet")
+                std::cerr << "Error: --bboFormat=parquet requires a build configured with -DMBO_WITH_PARQUET=ON\n";
+            else
+                std::cerr << "Error: --bboFormat must be csv, binary or parquet, got " << format << "\n";
+            return 5;
+        }
+
+        if (auto shards = result["shards"].as<std::size_t>(); shards == 0 || shards > 64)
+        {
+            std::cerr << "Error: --shards must be between 1 and 64, got " << shards << "\n";
+            return 6;
+        }
+
         // Initialize the Config singleton with parsed options
         Config::getInstance().initialize(result);
 
@@ -1,16 +1,27 @@
 #pragma once
 
+#include <atomic>
+#include <deque>
+#include <exception>
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <iomanip>
+#include <memory>
 #include <sstream>
 #include <fstream>
+#include <thread>
 #include <vector>
 #include <unordered_map>
 #include <boost/bimap.hpp>
 #include <boost/bimap/unordered_set_of.hpp>
 
+#include "BBOFile.hpp"
+#include "ChunkWriter.hpp"
+#include "Config.hpp"
 #include "Order.hpp"
+#include "ParquetBBOWriter.hpp"
+#include "SpscRing.hpp"
 #include "cfepitch.h"
 #include "Symbol.hpp"
 
@@ -21,43 +32,140 @@ class DataExporter
 public:
     using PacketInfos = std::tuple<std::time_t, uint32_t, uint32_t, uint64_t, uint64_t>;
     using SymbolToReadableBimap = boost::bimap<boost::bimaps::unordered_set_of<Symbol, std::hash<Symbol>>, boost::bimaps::unordered_set_of<std::string>>;
+    // Record handed to the export stage: everything it formats travels with it
+    struct BBOUpdate
+    {
+        BBORecord record;                              // symbol: index in the dictionary of the exporter that made it
+        const std::pair<Symbol, std::string>* symbol;  // That dictionary entry, entries never move
+        uint64_t flushOrder;                           // Orders the records of one message across streams, see set_flush_order
+    };
+    // Records of one producer on their way to the export stage, in feed order
+    struct BBOStream
+    {
+        BBOStream(std::size_t ringSize, Doorbell* exportBell);
+
+        // --shards: the decoder handed the producer an event of message msgSeqNum
+        void hand(uint64_t msgSeqNum) noexcept;
+        // --shards: the producer applied the event of message msgSeqNum and pushed its records
+        void apply(uint64_t msgSeqNum) noexcept;
+
+        SpscRing<BBOUpdate> ring;
+        // --shards merge: sequence numbers of the last event handed to the producer and of the last one it applied.
+        // A producer holds at most one event per message, so once they agree it is done up to the decoder.
+        alignas(SpscRing<BBOUpdate>::CacheLine) std::atomic<uint64_t> handedThrough;
+        alignas(SpscRing<BBOUpdate>::CacheLine) std::atomic<uint64_t> appliedThrough;
+        Doorbell* exportBell;
+    };
 public:
-    explicit DataExporter(std::size_t id) noexcept;
+    DataExporter() noexcept;
     DataExporter(const DataExporter& bbot) = delete;
     DataExporter& operator =(const DataExporter& bbot) = delete;
     DataExporter(DataExporter&& other) = delete;
     DataExporter& operator=(DataExporter&& other) = delete;
-    ~DataExporter() noexcept;
+    ~DataExporter() noexcept; // Closes an open BBO file under its temporary name if finish() was not called, errors are lost
 
     void set_obm(OrderBookManager* obm);
+    // End of the day: closes the BBO file (created header only if the day had no record) and names it after the
+    // last date set, throws std::ios_base::failure
+    void finish();
     void set_date(std::time_t date);
     void set_time_ref(uint32_t time) noexcept;
-    void set_time_offset(uint32_t time) noexcept;
-    void set_packet_infos(uint64_t pktSqNum, uint64_t msgSqNum) noexcept;
+    // Time offset and feed position of the message the next BBO records come from
+    void set_message_infos(uint32_t timeOffset, uint64_t pktSqNum, uint64_t msgSqNum) noexcept;
+    uint64_t message_seq_num() const noexcept;
+    // --conflate: the books a TransactionEnd flushes are published in the order the transaction first touched
+    // them, given here as the sequence number of that message (0 outside a flush). The --shards merge orders the
+    // records of the same message by it.
+    void set_flush_order(uint64_t msgSqNum) noexcept;
     std::string get_human_readable_symbol(const Symbol& symbol) const noexcept;
-    void store_BBO_records(char msgType, const Symbol& symbol, Order::Price bidPrice, uint32_t bidQuantity,
-                   Order::Price askPrice, uint32_t askQuantity, uint8_t tradingStatus) noexcept;
-    void write_BBO_to_binary(char msgType, const std::string& symbol, Order::Price bidPrice, uint32_t bidQuantity,
-                                       Order::Price askPrice, uint32_t askQuantity, uint8_t tradingStatus);
+    // Index of the symbol in the BBO symbol dictionary, added on first use (callers cache it)
+    uint32_t bbo_symbol(const Symbol& symbol);
+    // Appends a record to the BBO file in the --bboFormat format, or queues it for the export stage
+    // Throws std::ios_base::failure if the file cannot be opened or written
+    void store_BBO_records(char msgType, uint32_t symbol, Order::Price bidPrice, uint32_t bidQuantity,
+                   Order::Price askPrice, uint32_t askQuantity, uint8_t tradingStatus);
+    // --pipeline: from now on records are formatted and written by a thread of their own. A single stream carries
+    // the records of this exporter; several (--shards) carry those of shard exporters (see forward_to), merged
+    // by message sequence number.
+    void start_export_stage(std::size_t ringSize, std::size_t streams = 1);
+    // Formats the queued records and joins the thread, rethrows what stopped it. The producers must be done.
+    void stop_export_stage();
+    std::size_t export_streams() const noexcept; // 0 if the stage never started
+    BBOStream& export_stream(std::size_t i) noexcept;
+    const BBOStream& export_stream(std::size_t i) const noexcept;
+    double export_stage_ms() const noexcept;  // Lifetime of the export thread
+    double export_wait_ms() const noexcept;   // Part of it spent waiting for records
+    // Shard exporter (--shards): records go to stream (nullptr without --bbo), for the export stage of another
+    // exporter. No file is written.
+    void forward_to(BBOStream* stream) noexcept;
+    // --shards decoder: every event of the messages up to msgSeqNum has been handed to the streams' producers
+    void set_decoded_through(uint64_t msgSeqNum) noexcept;
+    // --shards decoder, the capture ends inside a transaction: the shards flush the books it held, stamped with
+    // msgSeqNum, each on its own. The merge keeps the records from there until no stream can add to them.
+    void hold_from(uint64_t msgSeqNum) noexcept;
+    // BBO records formatted so far and the time spent formatting them (only measured with --time)
+    uint64_t bbo_records() const noexcept;
+    double bbo_format_ms() const noexcept;
     void symbol_tostring(const Symbol& symbol, FuturesInstrumentDefinition m, const unsigned char *message) noexcept;
     void orderbook_printer(const std::string& symbol, const std::string& time);
 
 private:
     void time_stamp_tostring() noexcept;
-    void flush_binary_buffer();
-    void flush_csv_buffer();
+    // Renders "YYYY-MM-DD HH:MM:SS." once per second of exchange time, records only add the nanoseconds
+    void render_time_prefix(uint64_t second) noexcept;
+    // Formats and writes one record of source (the exporter or stream it comes from). Only reads the record
+    // and the formatting state below, so it runs on the export thread as well as inline.
+    void export_BBO(BBORecord record, const std::pair<Symbol, std::string>& symbol, std::size_t source);
+    void write_BBO_to_csv(const BBORecord& record, const std::string& symbol) noexcept;
+    void export_loop() noexcept;
+    void merge_streams();
+    uint64_t bbo_timestamp() const noexcept; // Nanoseconds since the Epoch of the current message, as L3Event::timestamp
+    std::string bbo_filename(std::string_view date) const;
+    bool bbo_open() const noexcept;
+    void open_bbo(std::string_view date); // On the first record, under a temporary name (see finish)
+    void flush_bbo();
+    // Appends the symbol dictionary, closes the file and fills in the header left blank by open_bbo
+    void finish_binary_bbo();
 
 private:
     OrderBookManager* m_obm;
-    std::ostringstream m_bboBuffer;
-    std::ofstream m_binaryOutfile; // Binary file stream
+    ChunkWriter m_bboWriter; // BBO csv or binary file, written out by its own thread as the day goes
+    BBOFormat m_bboFormat;
+#ifdef MBO_WITH_PARQUET
+    std::unique_ptr<ParquetBBOWriter> m_parquetWriter; // Only with --bboFormat=parquet
+#endif
     SymbolToReadableBimap m_symbolToReadableMap;  // Symbol to readable <-> readable to symbol bimap
-    std::string m_filename;
+    std::deque<std::pair<Symbol, std::string>> m_bboSymbols; // BBO symbol dictionary: feed and readable symbols
+    BBOStream* m_output;         // Where store_BBO_records hands the records over, nullptr to format them inline
+    bool m_forwarding;           // Shard exporter
+    bool m_finished;
+    // Export stage (--pipeline), the formatting state below then belongs to its thread
+    std::vector<std::unique_ptr<BBOStream>> m_exportStreams;
+    std::thread m_exportThread;
+    std::exception_ptr m_exportError;
+    uint64_t m_exportNs;
+    uint64_t m_exportWaitNs;
+    Doorbell m_exportBell;       // Where the export thread sleeps while no stream lets it go on
+    alignas(SpscRing<BBOUpdate>::CacheLine) std::atomic<uint64_t> m_decodedThrough;
+    std::atomic<uint64_t> m_heldFrom;    // UINT64_MAX unless hold_from was called
+    // Formatting state
+    std::string m_bboFilename;
+    std::vector<std::pair<Symbol, std::string>> m_exportSymbols; // Dictionary of the file, in the order of the first records
+    std::vector<std::vector<uint32_t>> m_symbolMaps;             // Per source: its dictionary index -> m_exportSymbols index
+    char m_timePrefix[24];       // "YYYY-MM-DD HH:MM:SS." of m_prefixSecond
+    std::size_t m_timePrefixSize;
+    uint64_t m_prefixSecond;     // Seconds since the Epoch, UINT64_MAX until the first record
+    bool m_timed;                // --time: measure the formatting of BBO records
+    uint64_t m_bboRecords;
+    uint64_t m_bboFormatNs;
     // The following are cached data used to improve performance
     char m_Time[30];
     char m_date[12];
+    uint64_t m_midnight;         // Seconds since the Epoch of the exchange's midnight of m_date
+    int32_t m_utcOffset;         // Seconds from UTC to the exchange wall clock
     uint32_t m_timeRef;
     uint32_t m_timeOffset;
     uint64_t m_pktSqNum;
     uint64_t m_msgSqNum;
+    uint64_t m_flushOrder;
 };
\ No newline at end of file
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "ChunkWriter.hpp"
+#include "Order.hpp"
+#include "PcapReader.hpp"
+
+// Normalized L3 event log of one day (--eventLog): the sequenced unit 1 messages that matter to the books,
+// decoded once into fixed-size records with an absolute timestamp and, where the message names a symbol,
+// the book index it resolved to. Later runs replay it instead of the capture (see CBOEPcapParser::replay).
+//
+//   EventLogHeader                     64 bytes
+//   L3Event[eventCount]                40 bytes each, in feed order
+//   u_char definitions[]               FuturesInstrumentDefinition messages referenced by Instrument events
+//
+// Like the binary BBO file, the header is written last: a log whose writer did not finish is rejected.
+
+enum class L3EventType : uint8_t
+{
+    Date,               // TimeReference: orderId = MidnightReference
+    Time,               // Time: orderId = seconds since midnight
+    Instrument,         // FuturesInstrumentDefinition: orderId = offset in the definitions, quantity = size
+    Add,                // flag = SideIndicator
+    Delete,
+    Modify,
+    Reduce,             // quantity = cancelled quantity
+    Execute,            // quantity = executed quantity
+    Trade,              // TradeLong/TradeShort, off book: flag = SideIndicator
+    Status,             // TradingStatus: flag = status
+    TransactionBegin,
+    TransactionEnd
+};
+
+struct L3Event
+{
+    static constexpr uint16_t NoBook = UINT16_MAX;
+
+    uint64_t timestamp;         // Exchange time in nanoseconds since the Epoch (MidnightReference + Time + TimeOffset)
+    uint64_t orderId;
+    int64_t price;
+    uint32_t quantity;
+    uint32_t pktSeqNum;
+    uint16_t book;              // Order::BookIndex of Instrument, Add, Trade and Status events, NoBook otherwise
+    L3EventType type;
+    uint8_t msgIndex;           // Position of the message in its packet: msgSeqNum - pktSeqNum
+    uint8_t flag;
+    uint8_t reserved[3];
+};
+static_assert(sizeof(L3Event) == 40, "L3Event must be 40 bytes");
+
+// Exchange clock of the feed: Date and Time events set the current second, the other events are stamped
+// with it plus the TimeOffset of their message. Shared by the log writer, the replay and the --pipeline stages.
+struct EventClock
+{
+    uint64_t midnight;          // Seconds since the Epoch
+    uint64_t time;              // Seconds since midnight
+
+    // (midnight + time) in nanoseconds
+    uint64_t second() const noexcept
+    {
+        return (midnight + time) * 1'000'000'000ull;
+    }
+
+    // Moves the clock on Date and Time events, then stamps event with its time and position in the feed
+    void stamp(L3Event& event, uint64_t pktSeqNum, uint64_t msgSeqNum, uint32_t timeOffset) noexcept
+    {
+        advance(event);
+        event.timestamp = second() + timeOffset;
+        event.pktSeqNum = static_cast<uint32_t>(pktSeqNum);
+        event.msgIndex = static_cast<uint8_t>(msgSeqNum - pktSeqNum);
+    }
+
+    // Moves the clock on Date and Time events, returns the TimeOffset event was stamped with
+    uint32_t advance(const L3Event& event) noexcept
+    {
+        if (event.type == L3EventType::Date)
+            midnight = event.orderId;
+        else if (event.type == L3EventType::Time)
+            time = event.orderId;
+        return static_cast<uint32_t>(event.timestamp - second());
+    }
+};
+
+struct EventLogHeader
+{
+    static constexpr char Magic[8] = {'M', 'B', 'O', 'L', '3', 'E', 'V', '\0'};
+    static constexpr uint32_t CurrentVersion = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t eventSize;         // sizeof(L3Event) of the writer
+    uint64_t sourceSize;        // Capture the log was built from, see EventLogSource
+    int64_t sourceMtime;
+    uint64_t rangeBegin;
+    uint64_t rangeEnd;
+    uint64_t eventCount;
+    uint64_t definitionsSize;   // The definitions follow the events
+};
+static_assert(sizeof(EventLogHeader) == 64, "EventLogHeader must be 64 bytes");
+
+// Capture and day range a log stands for: a log only replays for the exact bytes it was decoded from
+struct EventLogSource
+{
+    uint64_t size;
+    int64_t mtime;              // Modification time (ns)
+    DayRange range;
+
+    static EventLogSource of(const std::string& pcapFile, std::optional<DayRange> range);
+    // <capture>.<begin>-<end>.l3 for a day range, <capture>.l3 for a whole file
+    static std::string log_filename(const std::string& pcapFile, std::optional<DayRange> range);
+};
+
+// Writes the log while the capture is parsed, through a ChunkWriter
+class EventLogWriter
+{
+public:
+    EventLogWriter();
+    EventLogWriter(const EventLogWriter&) = delete;
+    EventLogWriter& operator=(const EventLogWriter&) = delete;
+
+    // Truncates or creates the file, throws std::ios_base::failure
+    void open(const std::string& filename, const EventLogSource& source);
+    bool is_open() const noexcept;
+    // Appends the definitions and writes the header, throws std::ios_base::failure. A log that is never
+    // closed (the day failed) keeps its blank header.
+    void close();
+
+    // Appends event, stamped with the clock of the log plus timeOffset. Date and Time events move the clock.
+    void append(L3Event event, uint64_t pktSeqNum, uint64_t msgSeqNum, uint32_t timeOffset);
+    // Instrument event carrying a copy of the FuturesInstrumentDefinition message
+    void append_instrument(Order::BookIndex book, const u_char* message, std::size_t size,
+                           uint64_t pktSeqNum, uint64_t msgSeqNum, uint32_t timeOffset);
+    uint64_t size() const noexcept;
+
+private:
+    ChunkWriter m_writer;
+    std::string m_filename;
+    EventLogSource m_source;
+    std::vector<u_char> m_definitions;
+    uint64_t m_eventCount;
+    EventClock m_clock;
+};
+
+// Memory-mapped event log: events are replayed in place
+class EventLogReader
+{
+public:
+    // Throws std::runtime_error if the file is not a complete event log of a supported version
+    explicit EventLogReader(const std::string& filename);
+    EventLogReader(const EventLogReader&) = delete;
+    EventLogReader& operator=(const EventLogReader&) = delete;
+
+    std::span<const L3Event> events() const noexcept;
+    // FuturesInstrumentDefinition message of an Instrument event, throws std::out_of_range if it is not in the log
+    std::span<const u_char> definition(const L3Event& event) const;
+    bool built_from(const EventLogSource& source) const noexcept;
+
+private:
+    MappedFile m_file;
+    EventLogHeader m_header;
+    std::span<const L3Event> m_events;
+    std::span<const u_char> m_definitions;
+};
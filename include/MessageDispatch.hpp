@@ -0,0 +1,211 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <sys/types.h>
+
+#include "cfepitch.h"
+
+// Sequenced messages of the CFE PITCH feed: X(type, struct of cfepitch.h) for each of them
+#define CFE_PITCH_MESSAGES(X)               \
+    X(0x20, Time)                           \
+    X(0x21, AddOrderLong)                   \
+    X(0x22, AddOrderShort)                  \
+    X(0x23, OrderExecuted)                  \
+    X(0x25, ReduceSizeLong)                 \
+    X(0x26, ReduceSizeShort)                \
+    X(0x27, ModifyOrderLong)                \
+    X(0x28, ModifyOrderShort)               \
+    X(0x29, DeleteOrder)                    \
+    X(0x2A, TradeLong)                      \
+    X(0x2B, TradeShort)                     \
+    X(0x2C, TradeBreak)                     \
+    X(0x2D, EndOfSession)                   \
+    X(0x31, TradingStatus)                  \
+    X(0x97, UnitClear)                      \
+    X(0xB1, TimeReference)                  \
+    X(0xB9, Settlement)                     \
+    X(0xBA, EndOfDaySummary)                \
+    X(0xBB, FuturesInstrumentDefinition)    \
+    X(0xBC, TransactionBegin)               \
+    X(0xBD, TransactionEnd)                 \
+    X(0xBE, PriceLimits)                    \
+    X(0xD3, OpenInterest)
+
+// Struct of a message type, no member for the types the feed does not define
+template<uint8_t Type>
+struct PitchMessage
+{
+};
+
+#define MBO_PITCH_MESSAGE(type, Struct)                         \
+    template<>                                                  \
+    struct PitchMessage<type>                                   \
+    {                                                           \
+        using Message = Struct;                                 \
+        static constexpr std::string_view Name = #Struct;       \
+    };
+CFE_PITCH_MESSAGES(MBO_PITCH_MESSAGE)
+#undef MBO_PITCH_MESSAGE
+
+struct MessageDescriptor
+{
+    uint8_t type;
+    uint8_t size;               // Smallest MsgLen of the type (its struct and the MessageHeader), 0 if it is not defined
+    std::string_view name;
+};
+
+// Descriptor of every message type, indexed by type
+inline constexpr std::array<MessageDescriptor, 256> PitchMessageTable = []
+{
+    std::array<MessageDescriptor, 256> table{};
+    for (std::size_t i = 0; i < table.size(); ++i)
+        table[i].type = static_cast<uint8_t>(i);
+#define MBO_PITCH_DESCRIPTOR(type, Struct) \
+    table[type] = {type, static_cast<uint8_t>(sizeof(Struct) + sizeof(MessageHeader)), #Struct};
+    CFE_PITCH_MESSAGES(MBO_PITCH_DESCRIPTOR)
+#undef MBO_PITCH_DESCRIPTOR
+    return table;
+}();
+
+// Where a message was found, handed to the sinks with it
+struct MessageContext
+{
+    uint64_t pktSeqNum;
+    uint64_t msgSeqNum;
+    uint8_t type;
+    uint8_t length;             // MsgLen, MessageHeader included
+};
+
+// Walks the sequenced unit 1 packets of the feed and hands every message to the sinks, in their order. A sink
+// takes what it implements, all optional and resolved at compile time:
+//
+//   void on_packet(const SequencedUnitHeader&)         every packet, before its messages
+//   void on_message(const MessageContext&)             every message, whatever its type
+//   void on(const M&, const MessageContext&)           messages of struct M, read in place from the packet
+//
+// Each type has its handler in a table built at compile time, calling the sinks inline. Messages of a type
+// the feed does not define, or shorter than their struct, are skipped and counted.
+template<typename... Sinks>
+class MessageDispatcher
+{
+public:
+    explicit MessageDispatcher(Sinks&... sinks) noexcept
+        : m_sinks{sinks...}, m_skipped{}
+    {
+    }
+
+    void packet(const u_char* packet)
+    {
+        // Skip PITCH packets for Unit other than 1, unsequenced PITCH packets, and those with zero messages (heartbeats)
+        int offset = 42;
+        const SequencedUnitHeader& suHeader = *reinterpret_cast<const SequencedUnitHeader*>(packet + offset);
+        if (suHeader.HdrUnit != 1 || suHeader.HdrSequence == 0 || suHeader.HdrCount == 0)
+        {
+            return;
+        }
+
+        std::apply([&](auto&... sinks)
+        {
+            (on_packet(sinks, suHeader), ...);
+        }, m_sinks);
+
+        MessageContext context{suHeader.HdrSequence, suHeader.HdrSequence, 0, 0};
+        offset += sizeof(SequencedUnitHeader);
+        for (int j = 0; j < suHeader.HdrCount; j++, context.msgSeqNum++)
+        {
+            const MessageHeader& msgHeader = *reinterpret_cast<const MessageHeader*>(packet + offset);
+            context.type = msgHeader.MsgType;
+            context.length = msgHeader.MsgLen;
+            message(context, packet + offset + sizeof(MessageHeader));
+            offset += msgHeader.MsgLen;
+        }
+    }
+
+    void message(const MessageContext& context, const u_char* message)
+    {
+        std::apply([&](auto&... sinks)
+        {
+            (on_message(sinks, context), ...);
+        }, m_sinks);
+
+        Handlers[context.type](*this, context, message);
+    }
+
+    // Messages skipped so far, by type
+    const std::array<uint64_t, 256>& skipped() const noexcept
+    {
+        return m_skipped;
+    }
+
+private:
+    using Handler = void (*)(MessageDispatcher&, const MessageContext&, const u_char*);
+
+    template<typename Message>
+    static void handle(MessageDispatcher& dispatcher, const MessageContext& context, const u_char* message)
+    {
+        if (context.length < PitchMessageTable[context.type].size) [[unlikely]]
+        {
+            ++dispatcher.m_skipped[context.type];
+            return;
+        }
+
+        // The structs are packed: they are read where they are
+        const Message& m = *reinterpret_cast<const Message*>(message);
+        std::apply([&](auto&... sinks)
+        {
+            (on(sinks, m, context), ...);
+        }, dispatcher.m_sinks);
+    }
+
+    static void skip(MessageDispatcher& dispatcher, const MessageContext& context, const u_char*)
+    {
+        ++dispatcher.m_skipped[context.type];
+    }
+
+    template<std::size_t... Types>
+    static constexpr std::array<Handler, 256> make_handlers(std::index_sequence<Types...>)
+    {
+        return {handler<Types>()...};
+    }
+
+    template<std::size_t Type>
+    static constexpr Handler handler()
+    {
+        if constexpr (requires { typename PitchMessage<Type>::Message; })
+            return &handle<typename PitchMessage<Type>::Message>;
+        else
+            return &skip;
+    }
+
+    template<typename Sink>
+    static void on_packet(Sink& sink, const SequencedUnitHeader& header)
+    {
+        if constexpr (requires { sink.on_packet(header); })
+            sink.on_packet(header);
+    }
+
+    template<typename Sink>
+    static void on_message(Sink& sink, const MessageContext& context)
+    {
+        if constexpr (requires { sink.on_message(context); })
+            sink.on_message(context);
+    }
+
+    template<typename Sink, typename Message>
+    static void on(Sink& sink, const Message& m, const MessageContext& context)
+    {
+        if constexpr (requires { sink.on(m, context); })
+            sink.on(m, context);
+    }
+
+    static constexpr std::array<Handler, 256> Handlers = make_handlers(std::make_index_sequence<256>{});
+
+private:
+    std::tuple<Sinks&...> m_sinks;
+    std::array<uint64_t, 256> m_skipped;
+};
@@ -1,44 +1,36 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
-#include <map>
-#include <string>
-#include <unordered_map>
+#include <utility>
 #include <vector>
 
 struct MessageInfo
 {
+  using TypeCounts = std::array<uint64_t, 256>; // Message counts indexed by type
+
   std::vector<std::pair<uint32_t, uint32_t>> packet_gaps;
   uint32_t gNextExpectedPacketSeqNum;
-  std::unordered_map<uint8_t, int> messageCounts; // Message counts by type
-  std::unordered_map<std::string, std::unordered_map<uint8_t, int>> dailyMessageCounts;
-   // Messages per day and type
-  int totalMessages = 0; // Total messages processed
-  std::map<uint8_t, std::string> messageTypeInfo =
+  TypeCounts messageCounts{}; // Message counts by type
+  // Trade dates (YYYYMMDD) in the order the feed announced them, 0 for the messages before the first TimeReference,
+  // and the message counts of each of them
+  std::vector<uint32_t> tradeDates{0};
+  std::vector<TypeCounts> dailyMessageCounts{TypeCounts{}};
+  std::size_t currentTradeDay = 0; // Index of the current trade date
+  uint64_t totalMessages = 0; // Total messages processed
+
+  // Makes tradeDate the current trade date, counted from zero the first time it is seen
+  void set_trade_date(uint32_t tradeDate)
+  {
+    // A few dates per capture: a linear search over them is all it takes
+    for (currentTradeDay = 0; currentTradeDay < tradeDates.size(); ++currentTradeDay)
     {
-        {0x20, "Time"},
-        {0x21, "AddOrderLong"},
-        {0x22, "AddOrderShort"},
-        {0x23, "OrderExecuted"},
-        {0x25, "ReduceSizeLong"},
-        {0x26, "ReduceSizeShort"},
-        {0x27, "ModifyOrderLong"},
-        {0x28, "ModifyOrderShort"},
-        {0x29, "DeleteOrder"},
-        {0x2A, "TradeLong"},
-        {0x2B, "TradeShort"},
-        {0x2C, "TradeBreak"},
-        {0x2D, "EndOfSession"},
-        {0x31, "TradingStatus"},
-        {0x97, "UnitClear"},
-        {0xB1, "TimeReference"},
-        {0xB9, "Settlement"},
-        {0xBA, "EndOfDaySummary"},
-        {0xBB, "FuturesInstrumentDefinition"},
-        {0xBC, "TransactionBegin"},
-        {0xBD, "TransactionEnd"},
-        {0xBE, "PriceLimits"},
-        {0xD3, "OpenInterest"}
-    }; // Map of message type to message name
-  std::string currentTradeDate; // Current trade date
-};
\ No newline at end of file
+      if (tradeDates[currentTradeDay] == tradeDate)
+        return;
+    }
+
+    tradeDates.push_back(tradeDate);
+    dailyMessageCounts.emplace_back();
+  }
+};
@@ -2,16 +2,22 @@
 
 #include <cstdint>
 
-#include "Symbol.hpp"
 //test
 
+class PriceLevel;
+
+// Hot part of a resting order: only what book mutations touch, 32 bytes (two orders per cache line).
+// The price and side are those of the level the order rests in, the id and the quantities that book
+// building never reads live in OrderStore's cold side table (see OrderStore::ColdOrder).
 class Order
 {
 public:
     using Price = int64_t;
     using ID = uint64_t;
     using Quantity = uint16_t;
-    enum class Side
+    using BookIndex = uint16_t; // Dense index of the order book, assigned by OrderBookManager
+    using Handle = uint32_t;    // Slot of the order in OrderStore
+    enum class Side : uint8_t
     {
         Buy,
         Sell
@@ -19,30 +25,37 @@ public:
 
 public:
     // Constructors
-    explicit Order(ID id, const Symbol& symbol, Price price, Quantity quantity, Side side) noexcept;
+    explicit Order(Handle handle, BookIndex book, Quantity quantity) noexcept;
     Order(const Order& order) = default;
     Order& operator=(const Order& order) = default;
     Order(Order&& order) noexcept = default;
     Order& operator=(Order&& order) noexcept = default;
     ~Order() noexcept = default;
 
-    ID get_id() const noexcept;
-    const Symbol& get_symbol() const noexcept;
-    Quantity get_initial_quantity() const noexcept;
+    Handle get_handle() const noexcept;
+    BookIndex get_book() const noexcept;
     Quantity get_remaining_quantity() const noexcept;
-    Quantity get_tradable_quantity() const noexcept;
+    // Price and side of the level, the order must be resting (asserted: neither is kept once it leaves its level)
     Side get_side() const noexcept;
     Price get_price() const noexcept;
+    PriceLevel* get_level() const noexcept; // Level whose queue holds the order, nullptr if not resting
     bool is_filled() const noexcept;
-    void print_info() const;
     void fill(Quantity quantity);
+    // fill() without the overfill check, for BookPolicy without integrity checks
+    void fill_unchecked(Quantity quantity) noexcept;
+    // Replace the quantity in place; the caller moves the order to the level of its new price
+    void modify(Quantity quantity) noexcept;
+
+private:
+    friend class PriceLevel; // Maintains the queue links below
 
 private:
-    Symbol m_symbol;
-    ID m_id;
-    Price m_price;
-    Quantity m_initialQty;
+    Order* m_prev;       // Previous order in the level's FIFO queue (higher time priority)
+    Order* m_next;       // Next order in the level's FIFO queue
+    PriceLevel* m_level; // Level the order rests in
+    Handle m_handle;
     Quantity m_remainingQty;
-    Quantity m_tradableQty;
-    Side m_side;
+    BookIndex m_book;    // Book the order was added to
 };
+
+static_assert(sizeof(Order) == 32, "Order is meant to be half a cache line");
@@ -8,26 +8,31 @@
 #include <queue>
 #include <tuple>
 
+#include "BookPolicy.hpp"
 #include "DataExporter.hpp"
 #include "Order.hpp"
 #include "OrderStore.hpp"
+#include "PriceLadder.hpp"
 #include "cfepitch.h"
 #include "Symbol.hpp"
 
+// Mutations are templated on a BookPolicy (BBO tracking, integrity checks), explicitly instantiated in
+// OrderBook.cpp for every combination
 class OrderBook
 {
 public:
     using FilledOrders = std::vector<Order::ID>;
-    // Need to test between list/vector/deque for best performance
-    // So far, std::vector seems to be slightly faster. Even though removing element from the middle/beggining of a vector is more expensive
-    // than for a std::list/deque, it seems that cache locality overcompensate for that
-    using Bids = std::map<Order::Price, std::pair<Order::Quantity, std::vector<Order*>>, std::greater<Order::Price>>; 
-    using Asks = std::map<Order::Price, std::pair<Order::Quantity, std::vector<Order*>>, std::less<Order::Price>>;
+    // Live levels keep their orders in intrusive FIFO queues (see PriceLevel), the snapshots below copy them into vectors
+    using BidLadder = PriceLadder<std::greater<Order::Price>>;
+    using AskLadder = PriceLadder<std::less<Order::Price>>;
+    using Bids = BidLadder::Snapshot; // Copy of the bid side, best price first
+    using Asks = AskLadder::Snapshot;
     using TradingStatus = uint8_t;
     using BBO = std::tuple<Order::Price, int32_t, Order::Price, int32_t>; // use int32_t instead of Order::Quantity to account for unspecified state
 
 public:
-    explicit OrderBook(const Symbol& symbol, uint16_t contractSize, uint64_t tickSize, OrderStore* s_orderstore, DataExporter* s_dataExporter);
+    explicit OrderBook(const Symbol& symbol, Order::BookIndex index, uint16_t contractSize, uint64_t tickSize, OrderStore* s_orderstore, DataExporter* s_dataExporter,
+                       LadderType ladderType = LadderType::Map);
     OrderBook(const OrderBook& ob) = delete;
     OrderBook& operator=(const OrderBook& ob) = delete;
     OrderBook(OrderBook&& ob) = delete;
@@ -36,38 +41,78 @@ public:
 
     std::pair<Order::Price, Order::Quantity> get_best_bid() const noexcept;
     std::pair<Order::Price, Order::Quantity> get_best_ask() const noexcept;
+    // 0 when the side is empty, like get_best_bid/get_best_ask
     Order::Price get_best_bid_price() const noexcept;
     Order::Price get_best_ask_price() const noexcept;
     BBO get_bbo() const noexcept;
     Bids get_bids() const noexcept;
     Asks get_asks() const noexcept;
     TradingStatus get_trading_status() const noexcept;
+    const Symbol& get_symbol() const noexcept;
+    Order::BookIndex get_index() const noexcept;
     bool bids_empty() const noexcept;
     bool asks_empty() const noexcept;
     void print_book() const;
     bool contains(Order::ID order_id) const;
     const Order& find_order(Order::ID order_id) const;
 
+    template<typename Policy>
     void add_order(Order::ID id, Order::Price price, Order::Quantity quantity, Order::Side side);
-    void cancel_order(Order::ID order_id);
-    void modify_order(Order::ID order_id, Order::Price new_price, Order::Quantity new_qty);
-    void reduce_order(Order::ID order_id, Order::Quantity cxl_qty);
-    void execute_order(Order::ID order_id, Order::Quantity executed_qty);
+    template<typename Policy>
+    void cancel_order(Order::ID order_id) { cancel_order<Policy>(lookup(order_id)); }
+    template<typename Policy>
+    void modify_order(Order::ID order_id, Order::Price new_price, Order::Quantity new_qty) { modify_order<Policy>(lookup(order_id), new_price, new_qty); }
+    template<typename Policy>
+    void reduce_order(Order::ID order_id, Order::Quantity cxl_qty) { reduce_order<Policy>(lookup(order_id), cxl_qty); }
+    template<typename Policy>
+    void execute_order(Order::ID order_id, Order::Quantity executed_qty) { execute_order<Policy>(lookup(order_id), executed_qty); }
+    // Same mutations for an order already looked up (see OrderBookManager): no further id probe
+    template<typename Policy>
+    void cancel_order(const OrderStore::OrderRef& ref);
+    template<typename Policy>
+    void modify_order(const OrderStore::OrderRef& ref, Order::Price new_price, Order::Quantity new_qty);
+    template<typename Policy>
+    void reduce_order(const OrderStore::OrderRef& ref, Order::Quantity cxl_qty);
+    template<typename Policy>
+    void execute_order(const OrderStore::OrderRef& ref, Order::Quantity executed_qty);
     void update_tradingStatus(TradingStatus tradingStatus);
+    // BBO update held by a conflating policy (see BookPolicy::ConflateBBO), exported by flush_bbo
+    bool bbo_pending() const noexcept;
+    void flush_bbo();
 
 private:
-    // Those three functions are required to avoid double counting in BBO
-    void add_internal(Order::ID id, Order::Price price, Order::Quantity quantity, Order::Side side) noexcept;
-    void cancel_internal(Order::ID order_id) noexcept;
-    void reduce_internal(Order::ID order_id, Order::Quantity cxl_qty) noexcept;
+    OrderStore::OrderRef lookup(Order::ID order_id) const; // Throws if the order does not exist
+    // Whether a mutation at price on that side reaches the top of book: the side is empty or price is at or
+    // better than its best price. Must be asked before the mutation.
+    bool touches_top(Order::Side side, Order::Price price) const noexcept;
+    // Exports the BBO if it differs from the last one published
+    void publish_bbo(char reason);
+    // A mutation reached the top of book: publish now or hold until flush_bbo
+    template<typename Policy>
+    void top_touched(char reason);
+    // Takes quantity out of a resting order and its level
+    template<typename Policy>
+    void fill(Order& order, Order::Quantity quantity);
+    // Those two functions are required to avoid double counting in BBO
+    void reduce_internal(Order& order, Order::Quantity cxl_qty) noexcept;
+    void move_internal(Order& order, Order::Price new_price, Order::Quantity new_qty) noexcept;
+    void remove_from_level(const OrderStore::OrderRef& ref, Order::Quantity quantity) noexcept;
+    void erase_level(Order::Side side, Order::Price price) noexcept;
 
 private:
-    Asks m_asks; // Storage for ask limit orders
-    Bids m_bids; // Storage for bid limit orders
+    static constexpr uint32_t NoBBOSymbol = UINT32_MAX;
+
+private:
+    AskLadder m_asks; // Storage for ask limit orders
+    BidLadder m_bids; // Storage for bid limit orders
     Symbol m_symbol; // Symbol of the order book
+    Order::BookIndex m_index; // Position of the book in OrderBookManager, stored in its orders
     uint64_t m_tickSize; // Minimum price increment (in 1/100 cents units)
     OrderStore* m_orderstore; // Pointer to the order store located in CBOEParser
     DataExporter* m_dataExporter; // Pointer to the data exporter located in CBOEParser
     uint16_t m_contractSize;
     TradingStatus m_tradingStatus; // Current trading status of the order book
+    BBO m_bbo; // Last BBO published, only maintained by policies tracking the BBO
+    uint32_t m_bboSymbol; // Index of the symbol in the BBO file dictionary, looked up on the first BBO published
+    char m_pendingBBO; // Message type of the last mutation held for flush_bbo, 0 if none
 };
\ No newline at end of file
@@ -1,8 +1,12 @@
 #pragma once
 
-#include <unordered_map>
+#include <cstdint>
 #include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
 
+#include "BookPolicy.hpp"
 #include "OrderBook.hpp"
 #include "OrderStore.hpp"
 #include "DataExporter.hpp"
@@ -11,7 +15,8 @@
 class OrderBookManager
 {
 public:
-    using OrderBooks = std::unordered_map<Symbol, OrderBook>;
+    // Books are indexed by the dense Order::BookIndex assigned when their FuturesInstrumentDefinition arrives
+    using OrderBooks = std::vector<std::unique_ptr<OrderBook>>;
 
 public:
     explicit OrderBookManager(OrderStore* os, DataExporter* dataExporter) noexcept;
@@ -21,22 +26,58 @@ public:
     OrderBookManager& operator = (OrderBookManager&& ob) = delete;
     ~OrderBookManager() noexcept = default;
 
-    void add_orderbook(const Symbol& ob, uint16_t contractSize, uint64_t tickSize) noexcept;
-    void remove_orderbook(const Symbol& ob);
+    void add_orderbook(const Symbol& ob, uint16_t contractSize, uint64_t tickSize);
+    void remove_orderbook(const Symbol& ob); // Its resting orders are erased with it
+    // Order mutations, see BookPolicy (instantiated in OrderBookManager.cpp for every policy)
+    template<typename Policy>
     void add_order(Order::ID id, const Symbol& symbol, Order::Price price, Order::Quantity quantity, Order::Side side);
+    // Same with the book already resolved (event log replay)
+    template<typename Policy>
+    void add_order(Order::ID id, Order::BookIndex book, Order::Price price, Order::Quantity quantity, Order::Side side);
+    template<typename Policy>
     void cancel_order(Order::ID order_id);
+    template<typename Policy>
     void modify_order(Order::ID order_id, Order::Price new_price, Order::Quantity new_qty);
+    template<typename Policy>
     void reduce_order(Order::ID order_id, Order::Quantity new_qty);
+    template<typename Policy>
     void execute_order(Order::ID order_id, Order::Quantity executed_qty);
     void update_tradingStatus(const Symbol& symbol, OrderBook::TradingStatus tradingStatus);
+    void update_tradingStatus(Order::BookIndex book, OrderBook::TradingStatus tradingStatus);
+    // TransactionBegin/TransactionEnd: with a conflating policy the books touched in between publish their BBO
+    // once, at the end
+    void begin_transaction() noexcept;
+    void end_transaction();
+    // End of the day or capture: ends a transaction left open, as its missing TransactionEnd would
+    void finish();
 
     bool contains(const Symbol& ob) const noexcept;
+    std::optional<Order::BookIndex> find_book(const Symbol& ob) const noexcept;
     bool contains(Order::ID order_id) const noexcept;
     const OrderBook& operator[](const Symbol& ob) const;
     const Order& find_order(Order::ID order_id) const;
+    uint64_t order_messages() const noexcept; // Add/delete/modify/reduce/execute messages applied so far
+
+private:
+    OrderStore::OrderRef lookup(Order::ID order_id);
+    // Publishes or queues the BBO update a conflating policy held back in book
+    template<typename Policy>
+    void after_mutation(OrderBook& book);
+    // Book of a symbol through the sorted symbol table, throws std::out_of_range if it does not exist
+    OrderBook& book(const Symbol& symbol) const;
+    OrderBook& book(Order::BookIndex index) const; // Throws std::out_of_range if the book does not exist
+    std::vector<std::pair<uint64_t, Order::BookIndex>>::const_iterator find_symbol(const Symbol& symbol) const noexcept;
 
 private:
     OrderBooks m_orderbooks;
+    // (Symbol::key(), book index) sorted by key: a handful of cache lines searched by bisection.
+    // Only FuturesInstrumentDefinition messages insert, so keeping it sorted costs nothing on the order path.
+    std::vector<std::pair<uint64_t, Order::BookIndex>> m_symbolIndex;
     OrderStore* m_orderstore; // Pointer to the order store located in CBOEParser
     DataExporter* m_dataExporter;
+    uint64_t m_orderMessages;
+    bool m_inTransaction;
+    // Books holding a BBO update until the end of the transaction, with the sequence number of the message
+    // that first touched them
+    std::vector<std::pair<Order::BookIndex, uint64_t>> m_pendingBooks;
 };
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Order.hpp"
+
+// Routing table of the --shards decoder: order id -> shard owning the order's book. Add orders are dealt out
+// by book but the later messages of an order only carry its id, so the decoder keeps the shard of every live
+// order, and its remaining quantity to drop it when the books do (complete execution, delete). 16 byte
+// entries in a Robin Hood open-addressing index, the same scheme as the id index of OrderStore.
+class OrderRouter
+{
+public:
+    static constexpr uint8_t NoShard = UINT8_MAX;
+
+public:
+    OrderRouter();
+
+    // Pre-size the index for that many live orders
+    void reserve(std::size_t capacity);
+
+    // New order (or an id reused after its delete)
+    void add(Order::ID id, uint8_t shard, Order::Quantity quantity);
+    // The following return the shard of the order, NoShard if it is not live, and track it as OrderBook does
+    uint8_t erase(Order::ID id);
+    uint8_t modify(Order::ID id, Order::Quantity quantity);
+    uint8_t reduce(Order::ID id, Order::Quantity quantity);
+    uint8_t execute(Order::ID id, Order::Quantity quantity); // Dropped on a complete fill
+    std::size_t size() const noexcept;
+
+private:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    struct Slot_
+    {
+        Order::ID id;
+        Order::Quantity quantity;
+        uint16_t distance; // 1 + distance from the home bucket, 0 = empty
+        uint8_t shard;
+    };
+    static_assert(sizeof(Slot_) == 16, "OrderRouter slots must stay 16 bytes");
+
+private:
+    std::size_t bucket(Order::ID id) const noexcept;
+    std::size_t find_slot(Order::ID id) const noexcept;
+    void insert_slot(std::size_t i, Slot_ slot) noexcept;
+    void erase_slot(std::size_t i) noexcept;
+    void rehash(std::size_t slotCount);
+
+private:
+    std::vector<Slot_> m_slots;   // Power of two size
+    std::size_t m_shift;          // 64 - log2(m_slots.size())
+    std::size_t m_size;
+};
@@ -1,11 +1,41 @@
 #pragma once
 
-#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
 
 #include "Order.hpp"
-#include "Symbol.hpp"
+
+// Owner of every live order of a parser.
+// Hot orders (see Order) and their cold fields (ColdOrder) live in parallel fixed-size slabs (their address
+// never changes, freed slots are recycled) and are found by id through a Robin Hood open-addressing index.
+// Once reserve() has been called with the peak number of live orders, adding orders neither allocates nor
+// rehashes.
 class OrderStore
 {
+public:
+    using Handle = Order::Handle; // Stable slot of an order in the pool
+    static constexpr Handle InvalidHandle = UINT32_MAX;
+
+    // Fields book building never reads, kept out of the hot Order's cache lines
+    struct ColdOrder
+    {
+        Order::ID id;
+        Order::Quantity initialQty;
+        Order::Quantity tradableQty;
+    };
+
+    // Result of a single id lookup. The order carries its book and level, so a mutation needs no other probe.
+    struct OrderRef
+    {
+        Order* order = nullptr;
+        std::size_t slot = 0; // Position of the id in the index, valid until the store is next modified
+
+        explicit operator bool() const noexcept { return order != nullptr; }
+    };
+
 public:
     OrderStore() = default;
     OrderStore(const OrderStore& ob) = delete;
@@ -14,12 +44,63 @@ public:
     OrderStore& operator=(OrderStore&& ob) noexcept = default;
     ~OrderStore() noexcept = default;
 
-    [[nodiscard]] Order* add_order(Order::ID id, const Symbol& symbol, Order::Price price, Order::Quantity quantity, Order::Side side);
+    // Pre-size the pool and the index for that many live orders
+    void reserve(std::size_t capacity);
+
+    [[nodiscard]] Order* add_order(Order::ID id, Order::BookIndex book, Order::Quantity quantity);
+    // Inserts unless the id exists (one walk of the index), returns the order and whether it was inserted
+    std::pair<Order*, bool> try_add_order(Order::ID id, Order::BookIndex book, Order::Quantity quantity);
     void erase(Order::ID order_id);
+    void erase(const OrderRef& ref); // No lookup
     Order& operator[] (Order::ID order_id);
     const Order& operator[] (Order::ID order_id) const;
     bool contains(Order::ID order_id) const noexcept;
 
+    // Empty ref if the order does not exist
+    OrderRef lookup(Order::ID order_id) noexcept;
+    // InvalidHandle if the order does not exist
+    Handle find(Order::ID order_id) const noexcept;
+    Order& get(Handle handle) noexcept;
+    const Order& get(Handle handle) const noexcept;
+    ColdOrder& cold(const Order& order) noexcept;
+    const ColdOrder& cold(const Order& order) const noexcept;
+    void print_info(const Order& order) const;
+    std::size_t size() const noexcept;
+    // Highest number of orders live at once (slots handed out by the pool)
+    std::size_t capacity() const noexcept;
+    // Number of walks of the id index so far (lookups and insertions)
+    uint64_t probes() const noexcept;
+
+private:
+    static constexpr std::size_t ChunkShift = 12; // 4096 orders per slab
+    static constexpr std::size_t ChunkSize = std::size_t{1} << ChunkShift;
+
+    struct Storage_
+    {
+        alignas(Order) std::byte bytes[sizeof(Order)];
+    };
+
+    struct Slot_
+    {
+        Order::ID id;
+        Handle handle;
+        uint32_t distance; // 1 + distance from the home bucket, 0 = empty
+    };
+
+private:
+    Handle allocate();
+    std::size_t bucket(Order::ID order_id) const noexcept;
+    std::size_t find_slot(Order::ID order_id) const noexcept;
+    void insert_slot(std::size_t i, Slot_ slot) noexcept;
+    void rehash(std::size_t slotCount);
+
 private:
-    std::unordered_map<Order::ID, Order> m_orders;
-};
\ No newline at end of file
+    std::vector<std::unique_ptr<Storage_[]>> m_chunks;
+    std::vector<std::unique_ptr<ColdOrder[]>> m_coldChunks; // Same layout as m_chunks
+    std::vector<Handle> m_free;   // Recycled handles, reused last-in first-out (still in cache)
+    Handle m_nextHandle = 0;      // First handle never handed out
+    std::vector<Slot_> m_slots;   // Id index, power of two size
+    std::size_t m_shift = 64;     // 64 - log2(m_slots.size())
+    std::size_t m_size = 0;       // Live orders
+    mutable uint64_t m_probes = 0;
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "PcapReader.hpp"
+
+// Sidecar index (<capture>.idx) giving random access into a pcap file by time or sequence number.
+// Every m_interval sequenced packets of unit 1 it records where the packet starts and the feed
+// state in effect just before it, so a reader can resume from there instead of the first packet.
+class PacketIndex
+{
+public:
+    static constexpr uint32_t DefaultInterval = 1024;
+    static constexpr uint32_t Version = 1;
+
+    struct Entry
+    {
+        uint64_t offset;            // Byte offset of the pcap record header
+        uint64_t pcapTime;          // Capture timestamp in nanoseconds since the Epoch
+        uint32_t sequence;          // HdrSequence of the packet
+        uint32_t day;               // Index of the day (see days()) containing the packet
+        uint32_t time;              // Last Time (0x20) seen: seconds since midnight
+        uint32_t midnightReference; // Last TimeReference (0xB1) seen: midnight in seconds since the Epoch
+        uint32_t tradeDate;         // Last TimeReference (0xB1) seen: trade date YYYYMMDD
+        uint32_t reserved;
+    };
+    static_assert(sizeof(Entry) == 40, "PacketIndex::Entry must be 40 bytes");
+
+public:
+    // Open <pcapFile>.idx if it exists and matches the capture, otherwise build and save it
+    static PacketIndex load_or_build(const std::string& pcapFile, uint32_t interval = DefaultInterval);
+    static PacketIndex build(const std::string& pcapFile, uint32_t interval = DefaultInterval);
+    static std::optional<PacketIndex> load(const std::string& pcapFile);
+    static std::string index_filename(const std::string& pcapFile);
+    // Exchange time key of a "YYYY-MM-DD" / "HH:MM:SS[.nnnnnnnnn]" pair (same clock as exchange_seconds)
+    static uint64_t parse_exchange_time(const std::string& date, const std::string& time);
+
+    void save() const;
+
+    const std::vector<DayRange>& days() const noexcept;
+    const std::vector<Entry>& entries() const noexcept;
+    // Seconds since the Epoch of the exchange time in effect at the entry (date of the midnight reference + Time)
+    static uint64_t exchange_seconds(const Entry& entry) noexcept;
+
+    // Last entry at or before the given point, nullptr if the point precedes the first entry
+    const Entry* seek_pcap_time(uint64_t pcapTime) const noexcept;
+    const Entry* seek_exchange_time(uint64_t exchangeSeconds) const noexcept;
+    const Entry* seek_sequence(std::size_t day, uint32_t sequence) const noexcept;
+
+    // Smallest byte range that must be replayed, from the start of its day, to rebuild the books
+    // up to the given exchange time (used by --showOB)
+    std::optional<DayRange> replay_range(uint64_t exchangeSeconds) const noexcept;
+
+private:
+    explicit PacketIndex(const std::string& pcapFile, uint32_t interval);
+
+private:
+    std::string m_pcapFilename;
+    uint32_t m_interval;
+    uint64_t m_sourceSize;   // Size of the capture when indexed
+    int64_t m_sourceMtime;   // Modification time (ns) of the capture when indexed
+    std::vector<DayRange> m_days;
+    std::vector<Entry> m_entries;
+};
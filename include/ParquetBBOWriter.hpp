@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "Order.hpp"
+
+// Columnar BBO file (--bboFormat=parquet, built with -DMBO_WITH_PARQUET=ON). Records are buffered in
+// Arrow column builders and written out as a Parquet row group every rowGroupSize records, so memory
+// stays at one row group however long the day is. Schema:
+//
+//   timestamp       timestamp[ns, UTC]   delta encoded, since the Epoch as BBORecord::timestamp
+//   utc_offset      int32                seconds from UTC to the exchange wall clock (the Time column of the csv)
+//   pkt_seq_num     uint64               delta encoded
+//   msg_seq_num     uint64               delta encoded
+//   msg_type        utf8                 A, D, M, R or E
+//   symbol          dictionary<int32, utf8>
+//   bid_price       decimal(18, 2)       stored as int64 (feed units)
+//   bid_quantity    uint32
+//   ask_price       decimal(18, 2)
+//   ask_quantity    uint32
+//   trading_status  utf8
+//
+// Every column is zstd compressed. Arrow types are hidden from the includers of this header.
+class ParquetBBOWriter
+{
+public:
+    static constexpr std::size_t DefaultRowGroupSize = std::size_t{1} << 16;
+
+public:
+    explicit ParquetBBOWriter(std::size_t rowGroupSize = DefaultRowGroupSize);
+    ParquetBBOWriter(const ParquetBBOWriter&) = delete;
+    ParquetBBOWriter& operator=(const ParquetBBOWriter&) = delete;
+    ~ParquetBBOWriter() noexcept; // Closes the file, errors are lost: call close() to see them
+
+    // Truncates or creates the file, throws std::ios_base::failure
+    void open(const std::string& filename);
+    bool is_open() const noexcept;
+    // Writes the last row group and the footer, throws std::ios_base::failure
+    void close();
+
+    // Adds the next entry of the symbol dictionary, records refer to it by index
+    void add_symbol(std::string_view name);
+    // Writes a row group every rowGroupSize records, throws std::ios_base::failure and then leaves the file closed
+    void append(uint64_t timestamp, int32_t utcOffset, uint64_t pktSeqNum, uint64_t msgSeqNum, char msgType, uint32_t symbol,
+                Order::Price bidPrice, uint32_t bidQuantity, Order::Price askPrice, uint32_t askQuantity, uint8_t tradingStatus);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <pcap.h>
+
+// Read-only memory mapping of an entire file
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& filename);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) = delete;
+    MappedFile& operator=(MappedFile&& other) = delete;
+    ~MappedFile() noexcept;
+
+    const u_char* data() const noexcept;
+    std::size_t size() const noexcept;
+    // Hint the kernel that [begin, end) will be read front to back (aggressive read-ahead, early page reclaim)
+    void advise_sequential(std::size_t begin, std::size_t end) const noexcept;
+
+private:
+    const u_char* m_data;
+    std::size_t m_size;
+};
+
+// Byte range [begin, end) of one trading day inside the original pcap file
+struct DayRange
+{
+    std::size_t begin;
+    std::size_t end;
+};
+
+// One pcap record, pointing directly into the mapping (no copy)
+struct PcapRecord
+{
+    const u_char* data;   // Packet bytes
+    uint32_t caplen;      // Captured length
+    uint32_t len;         // Original length on the wire
+    uint64_t timestamp;   // Capture time in nanoseconds since the Epoch
+    std::size_t offset;   // Byte offset of the record header in the file
+};
+
+// Zero-copy pcap reader: walks the record headers of a memory-mapped capture.
+// Supports microsecond and nanosecond magic numbers in either byte order.
+class MmapPcapReader
+{
+public:
+    static constexpr std::size_t FileHeaderSize = 24;
+    static constexpr std::size_t RecordHeaderSize = 16;
+
+public:
+    explicit MmapPcapReader(const std::string& filename);
+    MmapPcapReader(const MmapPcapReader&) = delete;
+    MmapPcapReader& operator=(const MmapPcapReader&) = delete;
+
+    // Restrict reading to the records starting in [begin, end). begin must be a record boundary.
+    void set_range(std::size_t begin, std::size_t end);
+    bool next(PcapRecord& record) noexcept;
+
+    bool nanosecond() const noexcept;
+    std::size_t offset() const noexcept;
+    std::size_t file_size() const noexcept;
+    // Raw 24 byte file header, e.g. to copy it into a sliced output file
+    const u_char* file_header() const noexcept;
+
+private:
+    uint32_t read_u32(const u_char* p) const noexcept;
+
+private:
+    MappedFile m_file;
+    bool m_swapped;       // File was written on a host with the opposite byte order
+    bool m_nanosecond;    // Timestamps fractions are nanoseconds instead of microseconds
+    std::size_t m_offset;
+    std::size_t m_end;
+};
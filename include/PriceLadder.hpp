@@ -0,0 +1,279 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <numeric>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Order.hpp"
+#include "PriceLevel.hpp"
+
+// Storage used for one side of an order book
+enum class LadderType : uint8_t
+{
+    Map,  // std::map keyed by price: one tree lookup per access
+    Flat  // Contiguous array indexed by (price - base) / tick: O(1) access, best level tracked incrementally
+};
+
+// One side of an order book: price -> level (aggregated quantity and FIFO queue of orders).
+// Compare orders prices from best to worst: std::greater for bids, std::less for asks.
+//
+// The flat ladder covers a window of levels around the prices in use and recenters (moving every level,
+// which repoints their orders) when a price falls outside of it. Prices that are not a multiple of the
+// tick away from the base shrink the tick to their gcd, so a wrong or missing PriceIncrement only costs
+// memory. A window that would exceed MaxFlatLevels (e.g. a spread quoted at both extremes of its limits)
+// falls back to the map.
+template<typename Compare>
+class PriceLadder
+{
+public:
+    using Level = PriceLevel;
+    using Map = std::map<Order::Price, Level, Compare>;
+    // Copy of the side, detached from the live queues
+    using Snapshot = std::map<Order::Price, std::pair<Order::Quantity, std::vector<Order*>>, Compare>;
+
+    static constexpr std::size_t InitialFlatLevels = 256;
+    static constexpr std::size_t MaxFlatLevels = std::size_t{1} << 20;
+
+public:
+    explicit PriceLadder(LadderType type = LadderType::Map, uint64_t tickSize = 1)
+        : m_type{type}, m_map{}, m_levels{}, m_used{}, m_base{0},
+          m_tick{tickSize == 0 ? 1 : static_cast<Order::Price>(tickSize)}, m_count{0}, m_best{0}
+    {
+    }
+
+    LadderType type() const noexcept { return m_type; }
+
+    // Level at price, created empty if it does not exist (same semantics as std::map::operator[])
+    Level& operator[](Order::Price price)
+    {
+        if (m_type == LadderType::Map)
+            return map_level(price);
+
+        std::size_t i = slot(price);
+        if (m_type == LadderType::Map) // The window outgrew MaxFlatLevels
+            return map_level(price);
+
+        if (!m_used[i])
+        {
+            m_used[i] = 1;
+            m_levels[i].set_price(price, LadderSide);
+            if (m_count++ == 0 || better(i, m_best))
+                m_best = i;
+        }
+        return m_levels[i];
+    }
+
+    void erase(Order::Price price)
+    {
+        if (m_type == LadderType::Map)
+        {
+            m_map.erase(price);
+            return;
+        }
+
+        std::size_t i = index_of(price);
+        if (i == npos || !m_used[i])
+            return;
+
+        m_levels[i].clear();
+        m_used[i] = 0;
+
+        if (--m_count != 0 && i == m_best)
+            m_best = next_used(i);
+    }
+
+    bool empty() const noexcept
+    {
+        return m_type == LadderType::Map ? m_map.empty() : m_count == 0;
+    }
+
+    // Number of price levels
+    std::size_t size() const noexcept
+    {
+        return m_type == LadderType::Map ? m_map.size() : m_count;
+    }
+
+    // Best price and level, the ladder must not be empty
+    Order::Price best_price() const noexcept
+    {
+        return m_type == LadderType::Map ? m_map.begin()->first : price_at(m_best);
+    }
+
+    const Level& best_level() const noexcept
+    {
+        return m_type == LadderType::Map ? m_map.begin()->second : m_levels[m_best];
+    }
+
+    // Copy of the ladder ordered from best to worst price
+    Snapshot snapshot() const
+    {
+        Snapshot snapshot;
+        auto copy = [&snapshot](Order::Price price, const Level& level)
+        {
+            snapshot.emplace_hint(snapshot.end(), price,
+                std::pair{level.get_quantity(), std::vector<Order*>(level.begin(), level.end())});
+        };
+
+        if (m_type == LadderType::Map)
+        {
+            for (const auto& [price, level] : m_map)
+                copy(price, level);
+        }
+        else
+        {
+            for (std::size_t i = 0; i < m_levels.size(); ++i)
+            {
+                if (m_used[i])
+                    copy(price_at(i), m_levels[i]);
+            }
+        }
+        return snapshot;
+    }
+
+private:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+    // Bids are best at the top of the window, asks at the bottom
+    static constexpr bool Descending = std::is_same_v<Compare, std::greater<Order::Price>>;
+    static constexpr Order::Side LadderSide = Descending ? Order::Side::Buy : Order::Side::Sell;
+
+    Level& map_level(Order::Price price)
+    {
+        auto [it, inserted] = m_map.try_emplace(price);
+        if (inserted)
+            it->second.set_price(price, LadderSide);
+        return it->second;
+    }
+
+    Order::Price price_at(std::size_t i) const noexcept
+    {
+        return m_base + static_cast<Order::Price>(i) * m_tick;
+    }
+
+    bool better(std::size_t i, std::size_t j) const noexcept
+    {
+        return Descending ? i > j : i < j;
+    }
+
+    // Index of price in the current window, npos if it is outside or off the tick grid
+    std::size_t index_of(Order::Price price) const noexcept
+    {
+        Order::Price offset = price - m_base;
+        if (offset < 0 || offset % m_tick != 0)
+            return npos;
+
+        auto i = static_cast<std::size_t>(offset / m_tick);
+        return i < m_levels.size() ? i : npos;
+    }
+
+    // Index of price, recentering the window first if needed
+    std::size_t slot(Order::Price price)
+    {
+        if (m_count == 0)
+        {
+            // Nothing to move: just center the window on the new price
+            if (m_levels.empty())
+            {
+                m_levels.resize(InitialFlatLevels);
+                m_used.resize(InitialFlatLevels);
+            }
+            m_base = price - static_cast<Order::Price>(m_levels.size() / 2) * m_tick;
+            return m_levels.size() / 2;
+        }
+
+        Order::Price offset = price - m_base;
+        if (offset % m_tick != 0)
+        {
+            recenter(std::gcd(m_tick, offset), price);
+        }
+        else if (index_of(price) == npos)
+        {
+            recenter(m_tick, price);
+        }
+        return m_type == LadderType::Map ? npos : index_of(price);
+    }
+
+    // Next used level worse than i, there must be one
+    std::size_t next_used(std::size_t i) const noexcept
+    {
+        do
+        {
+            i = Descending ? i - 1 : i + 1;
+        } while (!m_used[i]);
+        return i;
+    }
+
+    // Rebuild the window on the given tick so that it covers every level in use and price
+    void recenter(Order::Price tick, Order::Price price)
+    {
+        Order::Price lo = price;
+        Order::Price hi = price;
+        for (std::size_t i = 0; i < m_levels.size(); ++i)
+        {
+            if (m_used[i])
+            {
+                lo = std::min(lo, price_at(i));
+                hi = std::max(hi, price_at(i));
+            }
+        }
+
+        auto needed = static_cast<std::size_t>((hi - lo) / tick) + 1;
+        if (needed > MaxFlatLevels / 2)
+        {
+            fall_back_to_map();
+            return;
+        }
+
+        // Leave as much room on both sides so prices drifting either way do not recenter again right away
+        std::size_t size = std::max(m_levels.size(), std::bit_ceil(needed * 2));
+        Order::Price base = lo - static_cast<Order::Price>((size - needed) / 2) * tick;
+
+        std::vector<Level> levels(size);
+        std::vector<uint8_t> used(size, 0);
+        Order::Price bestPrice = price_at(m_best);
+        for (std::size_t i = 0; i < m_levels.size(); ++i)
+        {
+            if (m_used[i])
+            {
+                auto j = static_cast<std::size_t>((price_at(i) - base) / tick);
+                levels[j] = std::move(m_levels[i]);
+                used[j] = 1;
+            }
+        }
+
+        m_levels = std::move(levels);
+        m_used = std::move(used);
+        m_base = base;
+        m_tick = tick;
+        m_best = static_cast<std::size_t>((bestPrice - base) / tick);
+    }
+
+    void fall_back_to_map()
+    {
+        for (std::size_t i = 0; i < m_levels.size(); ++i)
+        {
+            if (m_used[i])
+                m_map.emplace(price_at(i), std::move(m_levels[i]));
+        }
+        std::vector<Level>().swap(m_levels);
+        std::vector<uint8_t>().swap(m_used);
+        m_count = 0;
+        m_type = LadderType::Map;
+    }
+
+private:
+    LadderType m_type;
+    Map m_map;                      // LadderType::Map storage
+    std::vector<Level> m_levels;    // LadderType::Flat storage: level i is at price m_base + i * m_tick
+    std::vector<uint8_t> m_used;    // Whether level i exists
+    Order::Price m_base;
+    Order::Price m_tick;
+    std::size_t m_count;            // Number of levels in use
+    std::size_t m_best;             // Index of the best level, meaningless when m_count == 0
+};
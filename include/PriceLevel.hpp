@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+#include "Order.hpp"
+
+// Price level of one book side: price, side, aggregated quantity and FIFO queue of the resting orders.
+// Orders do not repeat the price and side of their level (see Order). The queue is intrusive (orders
+// carry their own prev/next links and a pointer back to their level), so pushing, unlinking any order
+// and reading the front are all O(1) without searching.
+// Moving a level repoints its orders to the new location; levels cannot be copied.
+class PriceLevel
+{
+public:
+    class Iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Order*;
+        using difference_type = std::ptrdiff_t;
+
+        Iterator() noexcept = default;
+        explicit Iterator(Order* order) noexcept : m_order{order} {}
+
+        Order* operator*() const noexcept { return m_order; }
+        Iterator& operator++() noexcept { m_order = m_order->m_next; return *this; }
+        Iterator operator++(int) noexcept { Iterator it = *this; ++*this; return it; }
+        bool operator==(const Iterator& other) const noexcept = default;
+
+    private:
+        Order* m_order = nullptr;
+    };
+
+public:
+    PriceLevel() noexcept = default;
+    PriceLevel(const PriceLevel&) = delete;
+    PriceLevel& operator=(const PriceLevel&) = delete;
+    PriceLevel(PriceLevel&& other) noexcept { steal(other); }
+    PriceLevel& operator=(PriceLevel&& other) noexcept
+    {
+        if (this != &other)
+            steal(other);
+        return *this;
+    }
+    ~PriceLevel() noexcept = default;
+
+    // Called by the ladder when the level comes into use
+    void set_price(Order::Price price, Order::Side side) noexcept { m_price = price; m_side = side; }
+    Order::Price get_price() const noexcept { return m_price; }
+    Order::Side get_side() const noexcept { return m_side; }
+
+    Order::Quantity get_quantity() const noexcept { return m_quantity; }
+    void add_quantity(Order::Quantity quantity) noexcept { m_quantity += quantity; }
+    void remove_quantity(Order::Quantity quantity) noexcept { m_quantity -= quantity; }
+
+    std::size_t size() const noexcept { return m_count; }
+    bool empty() const noexcept { return m_count == 0; }
+    Order* front() const noexcept { return m_head; }
+    Iterator begin() const noexcept { return Iterator{m_head}; }
+    Iterator end() const noexcept { return Iterator{}; }
+
+    // Append an order at the back of the queue (lowest time priority)
+    void push_back(Order* order) noexcept
+    {
+        order->m_prev = m_tail;
+        order->m_next = nullptr;
+        order->m_level = this;
+        if (m_tail)
+            m_tail->m_next = order;
+        else
+            m_head = order;
+        m_tail = order;
+        ++m_count;
+    }
+
+    // Unlink an order of this level, wherever it is in the queue
+    void erase(Order* order) noexcept
+    {
+        if (order->m_prev)
+            order->m_prev->m_next = order->m_next;
+        else
+            m_head = order->m_next;
+
+        if (order->m_next)
+            order->m_next->m_prev = order->m_prev;
+        else
+            m_tail = order->m_prev;
+
+        order->m_prev = order->m_next = nullptr;
+        order->m_level = nullptr;
+        --m_count;
+    }
+
+    // Forget every order (their links are left dangling) and the quantity
+    void clear() noexcept
+    {
+        m_head = m_tail = nullptr;
+        m_count = 0;
+        m_quantity = 0;
+    }
+
+private:
+    void steal(PriceLevel& other) noexcept
+    {
+        m_head = other.m_head;
+        m_tail = other.m_tail;
+        m_count = other.m_count;
+        m_quantity = other.m_quantity;
+        m_price = other.m_price;
+        m_side = other.m_side;
+        for (Order* order = m_head; order; order = order->m_next)
+        {
+            order->m_level = this;
+        }
+        other.clear();
+    }
+
+private:
+    Order* m_head = nullptr;
+    Order* m_tail = nullptr;
+    Order::Price m_price = 0;
+    uint32_t m_count = 0;
+    Order::Quantity m_quantity = 0;
+    Order::Side m_side = Order::Side::Buy;
+};
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+
+// Where a thread that ran out of work sleeps until another one makes progress. The sleeper spins for a while,
+// then yields, then parks in std::atomic::wait. ring() stays a fence and a load while nobody sleeps: the sleeper
+// raises its flag before checking its condition a last time, the ringer publishes its progress before looking
+// at the flag, so one of them always sees the other.
+class Doorbell
+{
+public:
+    static constexpr std::size_t CacheLine = 64;
+    static constexpr int SpinsBeforeYield = 256;
+    static constexpr int SpinsBeforeSleep = SpinsBeforeYield + 64;
+
+public:
+    Doorbell() noexcept
+        : m_rings{0}, m_sleeping{false}
+    {
+    }
+    Doorbell(const Doorbell&) = delete;
+    Doorbell& operator=(const Doorbell&) = delete;
+
+    // Sleeper (a single thread): returns once ready() holds, with the nanoseconds it took
+    template<typename Ready>
+    uint64_t wait(Ready&& ready)
+    {
+        if (ready())
+            return 0;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int spins = 0; !ready(); ++spins)
+        {
+            if (spins < SpinsBeforeYield)
+                continue;
+            if (spins < SpinsBeforeSleep)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            uint32_t rings = m_rings.load(std::memory_order_acquire);
+            m_sleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!ready())
+                m_rings.wait(rings, std::memory_order_acquire);
+            m_sleeping.store(false, std::memory_order_relaxed);
+        }
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Any thread, once the progress the sleeper may be waiting for is published
+    void ring() noexcept
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_sleeping.load(std::memory_order_relaxed))
+        {
+            m_rings.fetch_add(1, std::memory_order_release);
+            m_rings.notify_one();
+        }
+    }
+
+private:
+    alignas(CacheLine) std::atomic<uint32_t> m_rings;
+    std::atomic<bool> m_sleeping;
+};
+
+// Bounded lock-free queue between exactly one producer thread and one consumer thread (the --pipeline
+// stages). The capacity is rounded up to a power of two so positions wrap with a mask. Each side keeps a
+// copy of the other side's position and only reads the shared one, which moves a cache line between the
+// cores, when its copy says the ring is full or empty. A side that has to wait spins, yields, then sleeps on
+// its Doorbell until the other side moves, and the time it spent waiting is kept for the --time report.
+template<typename T>
+class SpscRing
+{
+public:
+    static constexpr std::size_t CacheLine = Doorbell::CacheLine;
+
+public:
+    // consumerBell: where the consumer sleeps, shared when it waits on more than this ring (the --shards merge)
+    explicit SpscRing(std::size_t capacity, Doorbell* consumerBell = nullptr)
+        : m_head{0}, m_cachedTail{0}, m_consumerWaitNs{0}, m_tail{0}, m_cachedHead{0}, m_producerWaitNs{0},
+          m_closed{false}, m_cancelled{false}, m_capacity{std::bit_ceil(capacity < 2 ? std::size_t{2} : capacity)},
+          m_slots{std::make_unique<T[]>(m_capacity)}, m_ownConsumerBell{}, m_producerBell{},
+          m_consumerBell{consumerBell ? consumerBell : &m_ownConsumerBell}
+    {
+    }
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer: waits while the ring is full, returns false (value dropped) once the consumer cancelled
+    bool push(T&& value)
+    {
+        std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_cachedHead == m_capacity)
+        {
+            m_producerWaitNs += m_producerBell.wait([&]
+            {
+                m_cachedHead = m_head.load(std::memory_order_acquire);
+                return tail - m_cachedHead < m_capacity || m_cancelled.load(std::memory_order_relaxed);
+            });
+            if (tail - m_cachedHead == m_capacity)
+                return false;
+        }
+
+        m_slots[tail & (m_capacity - 1)] = std::move(value);
+        m_tail.store(tail + 1, std::memory_order_release);
+        m_consumerBell->ring();
+        return true;
+    }
+
+    // Producer: no more values, pop() returns false once the ring is drained
+    void close() noexcept
+    {
+        m_closed.store(true, std::memory_order_release);
+        m_consumerBell->ring();
+    }
+
+    // Consumer: waits while the ring is empty, returns false once it is empty and closed
+    bool pop(T& value)
+    {
+        std::size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_cachedTail)
+        {
+            m_consumerWaitNs += m_consumerBell->wait([&]
+            {
+                // Read closed first: a push made before close() is then seen by the load of the tail
+                bool closed = m_closed.load(std::memory_order_acquire);
+                m_cachedTail = m_tail.load(std::memory_order_acquire);
+                return head != m_cachedTail || closed;
+            });
+            if (head == m_cachedTail)
+                return false;
+        }
+
+        value = std::move(m_slots[head & (m_capacity - 1)]);
+        m_head.store(head + 1, std::memory_order_release);
+        m_producerBell.ring();
+        return true;
+    }
+
+    // Consumer: pop() without the wait, false if the ring is empty right now
+    bool try_pop(T& value)
+    {
+        std::size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_cachedTail)
+        {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            if (head == m_cachedTail)
+                return false;
+        }
+
+        value = std::move(m_slots[head & (m_capacity - 1)]);
+        m_head.store(head + 1, std::memory_order_release);
+        m_producerBell.ring();
+        return true;
+    }
+
+    // Consumer: closed and everything popped
+    bool drained() const noexcept
+    {
+        return m_closed.load(std::memory_order_acquire) &&
+               m_head.load(std::memory_order_relaxed) == m_tail.load(std::memory_order_acquire);
+    }
+
+    // Consumer: stops taking values (it failed), a producer waiting on a full ring gives up
+    void cancel() noexcept
+    {
+        m_cancelled.store(true, std::memory_order_relaxed);
+        m_producerBell.ring();
+    }
+
+    std::size_t capacity() const noexcept { return m_capacity; }
+    // Time each side spent waiting on the other one, to be read once both are done
+    double producer_wait_ms() const noexcept { return m_producerWaitNs / 1e6; }
+    double consumer_wait_ms() const noexcept { return m_consumerWaitNs / 1e6; }
+
+private:
+    // Consumer side
+    alignas(CacheLine) std::atomic<std::size_t> m_head;    // Next position to pop
+    std::size_t m_cachedTail;
+    uint64_t m_consumerWaitNs;
+    // Producer side
+    alignas(CacheLine) std::atomic<std::size_t> m_tail;    // Next position to push
+    std::size_t m_cachedHead;
+    uint64_t m_producerWaitNs;
+    // Shared, read-mostly
+    alignas(CacheLine) std::atomic<bool> m_closed;
+    std::atomic<bool> m_cancelled;
+    std::size_t m_capacity;
+    std::unique_ptr<T[]> m_slots;
+    Doorbell m_ownConsumerBell;
+    Doorbell m_producerBell;
+    Doorbell* m_consumerBell;
+};
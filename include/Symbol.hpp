@@ -6,7 +6,7 @@
 
 struct Symbol
 {
-    Symbol(uint8_t* symb)
+    Symbol(const uint8_t* symb)
     {
         std::memcpy(symbol, symb, 6);
     }
@@ -19,6 +19,13 @@ struct Symbol
         // Check that the two byte arrays are equal
         return std::memcmp(symbol, other.symbol, 6) == 0;
     }
+    // The 6 bytes as one integer: a single compare instead of a memcmp, used to index the books
+    uint64_t key() const noexcept
+    {
+        uint64_t key = 0;
+        std::memcpy(&key, symbol, 6);
+        return key;
+    }
 
     uint8_t symbol[6];
 };
@@ -29,15 +36,12 @@ namespace std
     template <>
     struct hash<Symbol> 
     {
-        std::size_t operator()(const Symbol& symb) const 
+        std::size_t operator()(const Symbol& symb) const noexcept
         {
-            std::size_t hash = 0;
-            // Could make even faster since first 3 char are 0 ?
-            for (int i = 0; i < 6; ++i) 
-            {
-                hash += symb.symbol[i] << i;
-            }
-            return hash;
+            // Symbols are mostly padding and share their prefix ("VX", spaces): summing bytes collided heavily.
+            // Multiply by 2^64/phi and fold the well-mixed high half down so every output bit depends on every byte.
+            uint64_t hash = symb.key() * 0x9E3779B97F4A7C15ull;
+            return static_cast<std::size_t>(hash ^ (hash >> 32));
         }
     };
 }
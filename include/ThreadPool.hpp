@@ -1,13 +1,134 @@
 #pragma once
 
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <deque>
 #include <vector>
 #include <thread>
 #include <functional>
-#include <queue>
+#include <memory>
 #include <mutex>
 #include <future>
-#include <condition_variable>
+#include <optional>
+#include <ranges>
 
+// Chase-Lev work-stealing deque (Le, Pop, Cohen, Zappa Nardelli, "Correct and Efficient Work-Stealing
+// for Weak Memory Models", PPoPP 2013).
+// Only the owner thread may push() and pop() (LIFO end), any thread may steal() (FIFO end).
+template<typename T>
+class WorkStealingDeque
+{
+    static_assert(std::is_trivially_copyable_v<T>, "WorkStealingDeque elements must be trivially copyable");
+
+public:
+    explicit WorkStealingDeque(std::size_t capacity = 1024)
+        : m_top{0}, m_bottom{0}, m_array{new Array(std::bit_ceil(capacity))}
+    {
+        m_arrays.emplace_back(m_array.load(std::memory_order_relaxed));
+    }
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    void push(T item)
+    {
+        int64_t b = m_bottom.load(std::memory_order_relaxed);
+        int64_t t = m_top.load(std::memory_order_acquire);
+        Array* array = m_array.load(std::memory_order_relaxed);
+
+        if (b - t > array->capacity - 1)
+        {
+            array = grow(array, t, b);
+        }
+        array->put(b, item);
+        m_bottom.store(b + 1, std::memory_order_release); // Publishes the item to thieves
+    }
+
+    std::optional<T> pop()
+    {
+        int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+        Array* array = m_array.load(std::memory_order_relaxed);
+        m_bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = m_top.load(std::memory_order_relaxed);
+
+        if (t > b) // Empty
+        {
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+
+        T item = array->get(b);
+        if (t == b) // Last item: race against thieves
+        {
+            bool won = m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+            if (!won)
+                return std::nullopt;
+        }
+        return item;
+    }
+
+    std::optional<T> steal()
+    {
+        int64_t t = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = m_bottom.load(std::memory_order_acquire);
+
+        if (t >= b)
+            return std::nullopt;
+
+        T item = m_array.load(std::memory_order_acquire)->get(t);
+        if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return std::nullopt; // Lost the race to the owner or another thief
+
+        return item;
+    }
+
+    bool empty() const noexcept
+    {
+        return m_bottom.load(std::memory_order_relaxed) <= m_top.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Array
+    {
+        explicit Array(std::size_t size)
+            : capacity{static_cast<int64_t>(size)}, mask{capacity - 1}, buffer{new std::atomic<T>[size]}
+        {}
+
+        void put(int64_t i, T item) noexcept { buffer[i & mask].store(item, std::memory_order_relaxed); }
+        T get(int64_t i) const noexcept { return buffer[i & mask].load(std::memory_order_relaxed); }
+
+        int64_t capacity;
+        int64_t mask;
+        std::unique_ptr<std::atomic<T>[]> buffer;
+    };
+
+    Array* grow(Array* array, int64_t top, int64_t bottom)
+    {
+        auto* bigger = new Array(static_cast<std::size_t>(array->capacity) * 2);
+        for (int64_t i = top; i != bottom; ++i)
+        {
+            bigger->put(i, array->get(i));
+        }
+        // Thieves may still be reading the old array: it is only released with the deque
+        m_arrays.emplace_back(bigger);
+        m_array.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+private:
+    alignas(64) std::atomic<int64_t> m_top;
+    alignas(64) std::atomic<int64_t> m_bottom;
+    std::atomic<Array*> m_array;
+    std::vector<std::unique_ptr<Array>> m_arrays; // Owned by the owner thread
+};
+
+// Work-stealing thread pool.
+// Tasks submitted from a worker (e.g. symbol shards of a day) go to that worker's own deque without locking;
+// tasks submitted from outside (e.g. days, files) go to a shared injection queue. Idle workers steal from each other.
 class ThreadPool
 {
 public:
@@ -15,55 +136,96 @@ public:
 
 public:
     explicit ThreadPool(size_t numWorkers);
-    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool(); // Runs every task still queued, then joins the workers
 
+    // Completion barrier: returns once every submitted task has finished running (not merely been dequeued).
+    // Must not be called from inside a task, use wait(future) there.
     void wait_all_done();
 
+    // Returns a future holding the task's result (or the exception it threw)
     template<typename F, typename... Args>
-    void enqueue(F&& function, Args&&... args)
+    std::future<std::invoke_result_t<F, Args...>> enqueue(F&& function, Args&&... args)
     {
         using ReturnType = std::invoke_result_t<F, Args...>;
 
         auto packt = std::packaged_task<ReturnType()>
-        { 
-            std::bind_front(std::forward<F>(function), std::forward<Args>(args)...) 
+        {
+            std::bind_front(std::forward<F>(function), std::forward<Args>(args)...)
         };
+        auto future = packt.get_future();
 
-        Task task{ [packt = std::move(packt)]() mutable { packt(); } };
+        Task* task = new Task{ [packt = std::move(packt)]() mutable { packt(); } };
+        submit(&task, 1);
+
+        return future;
+    }
+
+    // Bulk submission of function(item) for every item of the range, with one wake-up for the whole batch
+    template<std::ranges::input_range Range, typename F>
+    auto enqueue_range(Range&& items, F&& function)
+    {
+        using Item = std::ranges::range_value_t<Range>;
+        using ReturnType = std::invoke_result_t<F&, Item&>;
+
+        std::vector<std::future<ReturnType>> futures;
+        std::vector<Task*> tasks;
+        if constexpr (std::ranges::sized_range<Range>)
+        {
+            futures.reserve(std::ranges::size(items));
+            tasks.reserve(std::ranges::size(items));
+        }
+
+        for (auto&& item : items)
         {
-            std::lock_guard lk{ m_taskQueueMtx };
-            m_tasks.push(std::move(task));
+            std::packaged_task<ReturnType()> packt
+            {
+                [function, item = Item(item)]() mutable { return function(item); }
+            };
+            futures.push_back(packt.get_future());
+            tasks.push_back(new Task{ [packt = std::move(packt)]() mutable { packt(); } });
         }
-        m_taskQueueCV.notify_one();
-    } 
+        submit(tasks.data(), tasks.size());
+
+        return futures;
+    }
+
+    // Waits for a future, running queued tasks meanwhile when called from a worker (nested parallelism
+    // must not park the worker the awaited task may need)
+    template<typename T>
+    T wait(std::future<T>& future)
+    {
+        while (future.wait_for(std::chrono::seconds{0}) != std::future_status::ready)
+        {
+            if (!try_run_one())
+                std::this_thread::yield();
+        }
+        return future.get();
+    }
+
+    std::size_t size() const noexcept;
 
 private:
-    class Worker_
+    struct Worker_
     {
-    public:
-        explicit Worker_(ThreadPool* pool);
-        Worker_(const Worker_&) = delete;                 // Disable copying
-        Worker_& operator=(const Worker_&) = delete;      // Disable copy assignment
-        Worker_(Worker_&&) noexcept = default;           
-        Worker_& operator=(Worker_&&) noexcept = default; 
-
-        void request_stop();
-
-    private:
-        void run_task(std::stop_token st);
-    
-    private:
-        ThreadPool* m_pool;
-        std::jthread m_thread;
+        WorkStealingDeque<Task*> deque;
+        std::jthread thread;
     };
 
 private:
-    Task dequeue(std::stop_token& st);
+    void submit(Task* const* tasks, std::size_t count);
+    Task* find_task(std::size_t self);
+    bool try_run_one();
+    void run(Task* task);
+    void worker_loop(std::size_t self);
 
 private:
-    std::queue<Task> m_tasks;
-    std::vector<Worker_> m_workers;
-    std::mutex m_taskQueueMtx;
-    std::condition_variable_any m_taskQueueCV;
-    std::condition_variable m_allDoneCV;
+    std::vector<std::unique_ptr<Worker_>> m_workers;
+    std::deque<Task*> m_injected;         // Tasks submitted from outside the pool
+    std::mutex m_injectedMtx;
+    std::atomic<std::size_t> m_injectedCount;
+    alignas(64) std::atomic<std::size_t> m_pending;   // Submitted but not yet finished
+    alignas(64) std::atomic<uint64_t> m_wakeups;      // Bumped on every submission, idle workers wait on it
+    std::atomic<bool> m_stop;
 };
@@ -5,6 +5,9 @@
 Reference:
 
 CFE PITCH Specs v1.2.5 2023-11-28.pdf
+
+The messages the order books ignore carry the notes of the spec on what they are for, the others have them
+where they are handled (CBOEPcapParser::BookBuilder).
 */
 
 struct [[gnu::packed]] SequencedUnitHeader // Attribute [[gnu::packed]] prevents structure padding
@@ -30,6 +33,19 @@ struct [[gnu::packed]] Time // 0x20
 };
 static_assert(sizeof(Time) == 8, "Time struct must be 8 bytes");
 
+/*
+From the CFE PITCH Spec:
+
+"The Unit Clear message instructs feed recipients to clear all orders for
+the CFE book in the unit specified in the Sequenced Unit Header. It would be
+distributed in rare recovery events such as a data center fail-over. It may
+also be sent on system startup (after daily restart) when there are no
+persisted GTCs or GTDs."
+
+Additional notes:
+
+Under normal conditions, this message is never seen.
+*/
 struct [[gnu::packed]] UnitClear // 0x97
 {
     uint32_t TimeOffset;
@@ -64,6 +80,24 @@ struct [[gnu::packed]] FuturesInstrumentDefinition // 0xBB
 };
 static_assert(sizeof(FuturesInstrumentDefinition) == 43, "FuturesInstrumentDefinition struct must be 43 bytes");
 
+/*
+From the CFE PITCH Spec:
+
+"The Price Limits message is sent out at the start of a session for products
+subject to price limits per the contract specifications. The Price Limits
+message does not signal whether price limits are in effect for that symbol;
+it simply provides those values for when they are in effect. If multiple
+Price Limits messages are received for the same Symbol, the most recent
+values will override the previous values."
+
+Additional notes:
+
+In practice, price limits are so wide that no CFE instrument has reached its
+price limits ever in the entire history of trading.  So these are of
+questionable value.  They can also be trivially calculated based on the
+prior closing price.  Nevertheless, these may be used to e.g. visualize the
+limits on the client GUI.
+*/
 struct [[gnu::packed]] PriceLimits // 0xBE
 {
     uint32_t TimeOffset;
@@ -190,6 +224,26 @@ struct [[gnu::packed]] DeleteOrder // 0x29
 };
 static_assert(sizeof(DeleteOrder) == 12, "DeleteOrder struct must be 12 bytes");
 
+/*
+From the CFE PITCH Spec:
+
+"The Trade message provides information about executions that occur off of
+the CFE book (such as ECRP/Block trades). Trade messages are necessary to
+calculate CFE execution data. Trade messages do not alter the book and can
+be ignored if messages are being used solely to build a book. The Order Id
+sent in a Trade message is obfuscated and will not tie back to any real
+Order Id sent back via a FIX or BOE order entry session."
+
+Additional notes:
+
+Most commonly, TradeLong/TradeShort messages are sent when a spread
+instrument trades.  CFE sends OrderExecuted for the spread itself, and
+TradeLong/TradeShort for each of the legs.  As noted in the Spec, these can
+be ignored for the purposes of book-building because the actual book which
+trades is the spread book, not the legs. They may be useful for some other
+purposes like calculating leg trading volume.  When these are sent, almost
+always they are TradeShort and not TradeLong.
+*/
 struct [[gnu::packed]] TradeLong // 0x2A
 {
     uint32_t TimeOffset;
@@ -228,6 +282,20 @@ struct [[gnu::packed]] TransactionEnd // 0xBD
 };
 static_assert(sizeof(TransactionEnd) == 4, "TransactionEnd struct must be 4 bytes");
 
+/*
+From the CFE PITCH Spec:
+
+"The Trade Break message is sent whenever an execution on CFE is broken.
+Trade breaks are rare and only affect applications that rely upon CFE
+execution-based data. A Trade Break followed immediately be a new Trade with
+the same Execution Id indicates that a trade correction has occurred.
+Applications that simply build a CFE book can ignore Trade Break messages."
+
+Additional notes:
+
+As noted, these are rare.  There are none in the reference market data file
+for trade date 2023-11-16.
+*/
 struct [[gnu::packed]] TradeBreak // 0x2C
 {
     uint32_t TimeOffset;
@@ -235,6 +303,28 @@ struct [[gnu::packed]] TradeBreak // 0x2C
 };
 static_assert(sizeof(TradeBreak) == 12, "TradeBreak struct must be 12 bytes");
 
+/*
+From the CFE PITCH Spec:
+
+"Settlement messages are used to provide information concerning indicative,
+approved, or corrected daily and final settlement prices for CFE products.
+An indicative daily settlement price (Issue = I) is calculated by the system
+and sent immediately after an instrument closes trading but before the
+settlement price is approved. An approved settlement price (Issue = S) is
+sent once the CFE Trade Desk approves a settlement price for an instrument.
+If there is an error in the approved settlement price, then it may be
+re-issued (Issue = R). For symbols that settle each day using VWAP, the
+system will begin disseminating an intermediate indicative price update
+(Issue = i) at 2:59:35 p.m. CT (following the first interval of the VWAP
+calculation) that will be sent every five seconds, leading up to the receipt
+of the indicative daily settlement price (Issue = I)."
+
+Additional notes:
+
+Typically these are informational-only but there may be a trading strategy
+client interested in the indicative settlement prices.  Thus, a Feedhandler
+may want to forward these to clients.
+*/
 struct [[gnu::packed]] Settlement // 0xB9
 {
     uint32_t TimeOffset;
@@ -245,6 +335,21 @@ struct [[gnu::packed]] Settlement // 0xB9
 };
 static_assert(sizeof(Settlement) == 23, "Settlement struct must be 23 bytes");
 
+/*
+From the CFE PITCH Spec:
+
+"The Open Interest message is sent to communicate a symbol’s open interest,
+usually for the prior trading date. This message will be sent when open
+interest information is made available to CFE and may be sent multiple times
+if there are changes to the open interest for a symbol. The open interest is
+also populated in the End of Day Summary message."
+
+Additional notes:
+
+Most likely these are informational-only.  Maybe a client may want to store
+these daily values into the database for some later analysis.  These may
+usually be obtained from other sources, also.
+*/
 struct [[gnu::packed]] OpenInterest // 0xD3
 {
     uint32_t TimeOffset;
@@ -254,6 +359,22 @@ struct [[gnu::packed]] OpenInterest // 0xD3
 };
 static_assert(sizeof(OpenInterest) == 18, "OpenInterest struct must be 18 bytes");
 
+/*
+From the CFE PITCH Spec:
+
+"The End of Day Summary is sent immediately after trading ends for a symbol.
+No more Market Update messages will follow an End of Day Summary for a
+particular symbol. A value of zero in the Total Volume field means that no
+volume traded on that symbol for the day. The Total Volume field reflects
+all contracts traded during the day. Block, ECRP, and Derived (effective
+12/11/23) trades are included in the Total Volume field, but they are also
+reported separately to provide more detail.""
+
+Additional notes:
+
+Similar to OpenInterest, these would most likely be informational-only.  May
+be useful to store daily values to some database.
+*/
 struct [[gnu::packed]] EndOfDaySummary // 0xBA
 {
     uint32_t TimeOffset;
@@ -281,6 +402,20 @@ struct [[gnu::packed]] TradingStatus // 0x31
 };
 static_assert(sizeof(TradingStatus) == 16, "TradingStatus struct must be 16 bytes");
 
+/*
+From the CFE PITCH Spec:
+
+"The End of Session message is sent for each unit when the unit shuts down.
+No more sequenced messages will be delivered for this unit, but heartbeats
+from the unit may be received."
+
+Additional notes:
+
+Very last sequenced message on the feed.  Probably not very useful and can
+be ignored, since it's pretty clear when things shut down based on other
+data.  Perhaps could be used to double-check data integrity by verifying that
+it is indeed the last message.
+*/
 struct [[gnu::packed]] EndOfSession // 0x2D
 {
     uint32_t Timestamp;
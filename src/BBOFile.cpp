@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+
+#include "BBOFile.hpp"
+
+BBOReader::BBOReader(const std::string& filename)
+    : m_file{filename}, m_records{}, m_symbols{}, m_names{}
+{
+    if (m_file.size() < sizeof(BBOFileHeader))
+        throw std::runtime_error("Error: " + filename + " is too small to be a binary BBO file");
+
+    BBOFileHeader header;
+    std::memcpy(&header, m_file.data(), sizeof(header));
+
+    // A writer that did not finish leaves a zeroed header
+    if (std::memcmp(header.magic, BBOFileHeader::Magic, sizeof(header.magic)) != 0)
+        throw std::runtime_error("Error: " + filename + " is not a binary BBO file");
+    if (header.version != BBOFileHeader::CurrentVersion || header.recordSize != sizeof(BBORecord))
+        throw std::runtime_error("Error: " + filename + " has an unsupported binary BBO version " + std::to_string(header.version));
+
+    // Every section must lie inside the file
+    auto fits = [this](uint64_t offset, uint64_t size) { return offset <= m_file.size() && size <= m_file.size() - offset; };
+    if (header.recordCount > m_file.size() / sizeof(BBORecord) ||
+        !fits(sizeof(BBOFileHeader), header.recordCount * sizeof(BBORecord)) ||
+        !fits(header.symbolOffset, uint64_t{header.symbolCount} * sizeof(BBOSymbolEntry)) ||
+        !fits(header.namesOffset, header.namesSize) || header.symbolOffset % alignof(BBOSymbolEntry) != 0)
+    {
+        throw std::runtime_error("Error: " + filename + " is truncated");
+    }
+
+    // The mapping is page aligned and the sections are aligned for their types: records are used in place
+    const u_char* data = m_file.data();
+    m_records = {reinterpret_cast<const BBORecord*>(data + sizeof(BBOFileHeader)), static_cast<std::size_t>(header.recordCount)};
+    m_symbols = {reinterpret_cast<const BBOSymbolEntry*>(data + header.symbolOffset), header.symbolCount};
+    m_names = {reinterpret_cast<const char*>(data + header.namesOffset), static_cast<std::size_t>(header.namesSize)};
+
+    for (const BBOSymbolEntry& entry : m_symbols)
+    {
+        if (entry.nameOffset > m_names.size() || entry.nameSize > m_names.size() - entry.nameOffset)
+            throw std::runtime_error("Error: " + filename + " has a corrupt symbol dictionary");
+    }
+}
+
+std::span<const BBORecord> BBOReader::records() const noexcept
+{
+    return m_records;
+}
+
+std::size_t BBOReader::size() const noexcept
+{
+    return m_records.size();
+}
+
+const BBORecord& BBOReader::operator[](std::size_t i) const noexcept
+{
+    return m_records[i];
+}
+
+std::size_t BBOReader::symbol_count() const noexcept
+{
+    return m_symbols.size();
+}
+
+std::string_view BBOReader::symbol_name(uint32_t symbol) const noexcept
+{
+    const BBOSymbolEntry& entry = m_symbols[symbol];
+    return m_names.substr(entry.nameOffset, entry.nameSize);
+}
+
+std::optional<uint32_t> BBOReader::find_symbol(std::string_view name) const noexcept
+{
+    for (uint32_t i = 0; i < m_symbols.size(); ++i)
+    {
+        if (symbol_name(i) == name)
+            return i;
+    }
+    return std::nullopt;
+}
+
+std::size_t BBOReader::lower_bound(uint64_t timestamp) const noexcept
+{
+    auto it = std::ranges::lower_bound(m_records, timestamp, {}, &BBORecord::timestamp);
+    return static_cast<std::size_t>(it - m_records.begin());
+}
+
+void BBOReader::write_csv(std::ostream& os) const
+{
+    os << "Time,PktSeqNum,MsgSeqNum,MsgType,Symbol,BidPrice,BidQuantity,AskPrice,AskQuantity,TradingStatus\n";
+
+    char line[160];
+    for (const BBORecord& record : m_records)
+    {
+        uint64_t local = bbo_local_time(record);
+        std::time_t seconds = static_cast<std::time_t>(local / 1'000'000'000);
+        std::tm tm = *std::gmtime(&seconds);
+        int size = std::snprintf(line, sizeof(line), "%04d-%02d-%02d %02d:%02d:%02d.%09u,%llu,%llu,%c,",
+            tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+            static_cast<unsigned>(local % 1'000'000'000), static_cast<unsigned long long>(record.pktSeqNum),
+            static_cast<unsigned long long>(record.msgSeqNum), record.msgType);
+        os.write(line, size);
+
+        os << (record.symbol < m_symbols.size() ? symbol_name(record.symbol) : std::string_view{"?"});
+
+        char* p = line;
+        char* end = line + sizeof(line);
+        *p++ = ',';
+        p = bbo_price_to_chars(p, end, record.bidPrice);
+        *p++ = ',';
+        p = std::to_chars(p, end, record.bidQuantity).ptr;
+        *p++ = ',';
+        p = bbo_price_to_chars(p, end, record.askPrice);
+        *p++ = ',';
+        p = std::to_chars(p, end, record.askQuantity).ptr;
+        *p++ = ',';
+        *p++ = static_cast<char>(record.tradingStatus);
+        *p++ = '\n';
+        os.write(line, p - line);
+    }
+}
@@ -1,6 +1,12 @@
+#include <algorithm>
+#include <cerrno>
+#include <concepts>
+#include <ctime>
 #include <filesystem>
 #include <format>
+#include <memory>
 #include <regex>
+#include <thread>
 #include <sstream>
 #include <pcap.h>
 #include <iostream>
@@ -10,654 +16,1252 @@
 #include "CBOEPcapParser.hpp"
 #include "cfepitch.h"
 #include "Config.hpp"
+#include "MessageDispatch.hpp"
 #include "MessageInfo.hpp"
 #include "Order.hpp"
 #include "OrderBookManager.hpp"
 #include "OrderStore.hpp"
 #include "OrderBook.hpp"
+#include "PacketIndex.hpp"
 #include "DataExporter.hpp"
 #include "StopWatch.hpp"
 #include "Symbol.hpp"
 
 CBOEPcapParser::CBOEPcapParser(const std::string& filename, std::size_t id)
-    : m_pcapFilename{filename}, m_id{id}, m_messageInfo{}, m_orderstore{}, 
-    m_dataExporter{m_id}, m_obm{&m_orderstore, &m_dataExporter}
+    : m_pcapFilename{filename}, m_id{id}, m_range{}, m_messageInfo{}, m_orderstore{}, 
+    m_dataExporter{}, m_obm{&m_orderstore, &m_dataExporter}, m_eventLog{}, m_replayedEvents{0},
+    m_eventRing{}, m_decodeNs{0}, m_bookNs{0}, m_shards{}
 {
     m_dataExporter.set_obm(&m_obm);
 }
 
-void CBOEPcapParser::process_message(uint64_t pktSeqNum, uint64_t msgSeqNum, const u_char *message, int msg_type)
+CBOEPcapParser::CBOEPcapParser(const std::string& filename, std::size_t id, DayRange range)
+    : CBOEPcapParser(filename, id)
 {
-    switch (msg_type)
+    m_range = range;
+}
+
+CBOEPcapParser::BookShard::BookShard(std::size_t ringSize)
+    : store{}, exporter{}, obm{&store, &exporter}, events{ringSize}, thread{}, error{}, eventCount{0}, busyNs{0}
+{
+    exporter.set_obm(&obm);
+}
+
+Order::BookIndex CBOEPcapParser::define_instrument(const u_char* message, OrderBookManager& obm, DataExporter& dataExporter)
+{
+    FuturesInstrumentDefinition m = *(FuturesInstrumentDefinition*)message;
+    Symbol symbol(m.Symbol);
+
+    obm.add_orderbook(symbol, m.ContractSize, m.PriceIncrement);
+    // Pass the symbol to the data exporter for conversion to human-readable symbol
+    dataExporter.symbol_tostring(symbol, m, message);
+    return *obm.find_book(symbol);
+}
+
+// ------------------ Message sinks (see MessageDispatch.hpp) ------------------
+
+// Builds the order books of the day. The messages it has no handler for do not alter book state, see cfepitch.h.
+template<typename Policy>
+class CBOEPcapParser::BookBuilder
+{
+public:
+    BookBuilder(OrderBookManager& obm, DataExporter& dataExporter) noexcept
+        : m_obm{obm}, m_dataExporter{dataExporter}
     {
-        // NON-ORDER MESSAGES
-        // The following message types do not alter book state.  They may be used
-        // for information purposes in some Feedhandler implementations, or may be
-        // ignored altogether in other, minimalistic, implementations.
+    }
 
-        case 0x20: // Time
-        {
-            /*
-            From the CFE PITCH Spec:
+    // NON-ORDER MESSAGES
+    // The following message types do not alter book state.  They may be used
+    // for information purposes in some Feedhandler implementations, or may be
+    // ignored altogether in other, minimalistic, implementations.
 
-            "A Time message is immediately generated and sent when there is a PITCH
-            event for a given clock second. If there is no PITCH event for a given clock
-            second, then no Time message is sent for that second. All subsequent time
-            offset fields for the same unit will use the new Time value as the base
-            until another Time message is received for the same unit. The Time field is
-            the number of seconds relative to midnight Central Time, which is provided
-            in the Time Reference message. The Time message also includes the Epoch Time
-            field, which is the current time represented as the number of whole seconds
-            since the Epoch (Midnight January 1, 1970)."
+    void on(const Time& m, const MessageContext&) noexcept
+    {
+        /*
+        From the CFE PITCH Spec:
+
+        "A Time message is immediately generated and sent when there is a PITCH
+        event for a given clock second. If there is no PITCH event for a given clock
+        second, then no Time message is sent for that second. All subsequent time
+        offset fields for the same unit will use the new Time value as the base
+        until another Time message is received for the same unit. The Time field is
+        the number of seconds relative to midnight Central Time, which is provided
+        in the Time Reference message. The Time message also includes the Epoch Time
+        field, which is the current time represented as the number of whole seconds
+        since the Epoch (Midnight January 1, 1970)."
+
+        Additional notes:
+
+        Most messages contain "TimeOffset" field with nanoseconds-only part of time.
+        The "seconds" part is established by this Time message.  So Feedhandler
+        should keep track of this "seconds" part and update it with every Time
+        message.
+        */
+
+        m_dataExporter.set_time_ref(m.Time);
+    }
 
-            Additional notes:
+    void on(const TimeReference& m, const MessageContext&)
+    {
+        /*
+        From the CFE PITCH Spec:
 
-            Most messages contain "TimeOffset" field with nanoseconds-only part of time.
-            The "seconds" part is established by this Time message.  So Feedhandler
-            should keep track of this "seconds" part and update it with every Time
-            message.
-            */
+        "The Time Reference message is used to provide a midnight reference point
+        for recipients of the feed. It is sent whenever the system starts up and
+        when the system crosses a midnight boundary. All subsequent Time messages
+        for the same unit will the use the last Midnight Reference until another
+        Time Reference message is received for that unit. The Time Reference message
+        includes the Trade Date, so most other sequenced messages will not include
+        that information.""
 
-            Time m = *(Time*)message;
-            m_dataExporter.set_time_ref(m.Time);
+        Additional notes:
 
-            break;
-        }
+        Most likely this is never needed.
+        */
 
-        [[unlikely]] case 0x97: // UnitClear
-        {
-            /*
-            From the CFE PITCH Spec:
+        // Parse the midnight reference date(YYYYMMDD)
+        m_dataExporter.set_date(m.MidnightReference);
+    }
 
-            "The Unit Clear message instructs feed recipients to clear all orders for
-            the CFE book in the unit specified in the Sequenced Unit Header. It would be
-            distributed in rare recovery events such as a data center fail-over. It may
-            also be sent on system startup (after daily restart) when there are no
-            persisted GTCs or GTDs."
+    void on(const FuturesInstrumentDefinition& m, const MessageContext&)
+    {
+        /*
+        From the CFE PITCH Spec:
+
+        "The Futures Instrument Definition message can be sent as a sequenced
+        message or an unsequenced message. It is sent as a sequenced message when
+        the system starts up at the beginning of a trading session or if an
+        instrument is created or modified during a trading day. A new sequenced
+        message may be sent for a Symbol that does not visibly change any attribute.
+        One un-sequenced Futures Instrument Definition message for each Symbol is
+        also sent in a continuous loop, which completes approximately once every
+        minute."
+
+        Additional notes:
+
+        In theory, new instruments may be added intra-day and their instrument
+        definitions will be distributed via this message - but in practice this does
+        not happen.  So there is no need to continuously listen to instrument
+        definitions.  Mostly likely, these would be used just once to get instrument
+        descriptions - in approximately one minute all definitions can be received.
+        Or even more likely, the client system would already have all definitions
+        built by a different component and stored in e.g. configuration file; in
+        that case these messages can be completely ignored.
+        */
+
+        define_instrument(reinterpret_cast<const u_char*>(&m), m_obm, m_dataExporter);
+    }
 
-            Additional notes:
+    void on(const TransactionBegin&, const MessageContext&) noexcept
+    {
+        /*
+        From the CFE PITCH Spec:
+
+        "The Transaction Begin message indicates any subsequent messages, up to the
+        accompanying Transaction End message, are all part of the same transaction
+        block. One example of where this might be used is when a single aggressive
+        order executes against several resting orders. All PITCH messages
+        corresponding to such an event would be included between a Transaction Begin
+        and Transaction End. It is important to note that any PITCH Message Type may
+        be included in a transaction block and there is no guarantee that the
+        messages apply to the same price level or even the same Symbol. Transaction
+        Begin messages do not alter the book and can be ignored if messages are
+        being used solely to build a book. Feed processors can use a transaction
+        block as a trigger to postpone publishing a quote update until the end of
+        the transaction block. In the prior example of a single aggressive order
+        executing against multiple resting orders, a top of book feed would be able
+        to publish a single trade message and quote update resulting from multiple
+        Order Executed messages once it finished processing all of the messages
+        within the transaction block."
+
+        Additional notes:
+
+        In practice, messages included in the TransactionBegin-TransactionEnd block
+        are almost always OrderExecuted which result from one large agressor
+        executing against multiple smaller resting orders - the same example as used
+        in the CFE PITCH spec.  This is really a *single* match event, but due to
+        system design CFE published it as multiple events - one per resting order -
+        all with the same Exchange timestamp.  In practice number of messages is
+        often 10 to 20 but may also reach 100 or more.  Feedhandler should
+        definitely avoid publishing updates to clients before it completes
+        processing of a transaction block.
+        */
+
+        m_obm.begin_transaction();
+    }
 
-            Under normal conditions, this message is never seen.
-            */
+    void on(const TransactionEnd& m, const MessageContext& context)
+    {
+        /*
+        See comments for TransactionBegin.
+        */
 
-            // UnitClear m = *(UnitClear*)message;
-            break;
-        }
+        // Held BBO updates (--conflate) are stamped with the end of the transaction
+        stamp(m.TimeOffset, context);
+        m_obm.end_transaction();
+    }
 
-        case 0xB1: // TimeReference
-        {
-            /*
-            From the CFE PITCH Spec:
+    void on(const TradingStatus& m, const MessageContext&)
+    {
+        /*
+        From the CFE PITCH Spec:
+
+        "The Trading Status message is used to indicate the current trading status
+        of a Futures contract. A Trading Status message will be sent whenever a
+        security’s trading status changes. If a Trading Status has not been received
+        for a symbol, then the Trading Status for the symbol should be assumed to be
+        “S = Suspended”."
+
+        Additional notes:
+
+        These are sent for every instrument - both simple and complex (spreads).  In
+        general:
+        - Around 16:45 Central Time, instruments transition to "Q - Queing";
+        orders can be added but no trading yet
+        - Around 17:00 Central Time, instruments transition to "T - Trading";
+        trading is enabled
+        - Around 16:00 Central Time (next day), instruments transition to "S -
+        Suspended"; trading is closed
+
+        Note that some low-liquidity instruments, like exotic spreads or far-out
+        outrights, may transition between Q and T also at seemingly random time
+        during the trading day.
+        */
+
+        m_obm.update_tradingStatus(m.Symbol, m.TradingStatus);
+    }
 
-            "The Time Reference message is used to provide a midnight reference point
-            for recipients of the feed. It is sent whenever the system starts up and
-            when the system crosses a midnight boundary. All subsequent Time messages
-            for the same unit will the use the last Midnight Reference until another
-            Time Reference message is received for that unit. The Time Reference message
-            includes the Trade Date, so most other sequenced messages will not include
-            that information.""
+    // ORDER MESSAGES
+    // The following messages do alter book state.  In order to correctly build
+    // order books and maintain data integrity, it is essential to process every
+    // message correctly.  Even a single missed message will likely result in
+    // loss of data integrity.  Appropriate checks may and should be used in
+    // code.  For instance, all of OrderExecuted, ReduceSize, ModifyOrder, and
+    // DeleteOrder messages refer to the OrderId of an order which must exist;
+    // if Feedhandler is not able to find such OrderId it most likely means that
+    // it has missed on incorrectly processed some earlier message(s).
+    // OrderExecuted should only occur to orders at the top of the FIFO queue,
+    // and so on.  It is recommended that Feedhandler implements data integrity
+    // checks whether in a form of asserts, exceptions, or log messages -
+    // especially during the development stages while the code is not yet
+    // proven.
+
+    void on(const AddOrderLong& m, const MessageContext& context)
+    {
+        add(m, context);
+    }
 
-            Additional notes:
+    void on(const AddOrderShort& m, const MessageContext& context)
+    {
+        /*
+        From the CFE PITCH Spec:
+
+        "An Add Order message represents a newly accepted visible order on the CFE
+        book. It includes a day-specific Order Id assigned by CFE to the order."
+
+        Additional notes:
+
+        AddOrderLong/AddOrderShort is what adds orders to the books.  In the
+        reference market data file, there are about 700 thousand AddOrder messages.
+        Almost all of them are AddOrderShort - but once in a while CFE sends
+        AddOrderLong to keep things interesting, so it cannot be ignored.  It may be
+        useful to process these two together as a single message type to avoid code
+        duplication.
+
+        The first AddOrder messages for the day are typically sent around 16:07.
+        These are GTC orders that are left in books being restored.  There's usually
+        about 15 thousand GTC orders.  In order to maintain data integrity, it is
+        essential to listen to these GTC-restoring day orders or have them in PCAP.
+        Thus, a full day PCAP should start prior to this approximately 16:07 time.
+        All GTC-restoring AddOrder messages have the same Exchange timestamp and are
+        sent closely together, possibly at the maximum line rate of 10 Gbps.  Thus,
+        15 thousand or so messages may be received during a single millisecond
+        creating one of the peak daily load spikes.  It is, of course, important
+        that a Feedhandler is able to process this spike and does not drop any of
+        these messages.
+
+        It may be important for client strategies to know whether orders are GTC or
+        not.  So a Feedhandler may want to mark orders added during this
+        GTC-restoration cycle as GTC, as opposed to DAY orders added later.
+
+        In total, there are about 700 thousand AddOrder messages for the day.
+        */
+
+        add(m, context);
+    }
 
-            Most likely this is never needed.
-            */
+    void on(const OrderExecuted& m, const MessageContext& context)
+    {
+        /*
+        From the CFE PITCH Spec:
 
-            TimeReference m = *(TimeReference*)message;
-        
-            // Parse the midnight reference date(YYYYMMDD)            
-            m_dataExporter.set_date(m.MidnightReference);
-        
-            break;
-        }
+        "Order Executed messages are sent when an order on the CFE book is executed
+        in whole or in part. The execution price equals the limit order price found
+        in the original Add Order message or the limit order price in the latest
+        Modify Order message referencing the Order Id."
 
-        case 0xBB: // FuturesInstrumentDefinition
-        {
-            /*
-            From the CFE PITCH Spec:
+        Additional notes:
 
-            "The Futures Instrument Definition message can be sent as a sequenced
-            message or an unsequenced message. It is sent as a sequenced message when
-            the system starts up at the beginning of a trading session or if an
-            instrument is created or modified during a trading day. A new sequenced
-            message may be sent for a Symbol that does not visibly change any attribute.
-            One un-sequenced Futures Instrument Definition message for each Symbol is
-            also sent in a continuous loop, which completes approximately once every
-            minute."
+        CFE is strictly a First-In-First-Out (FIFO) market, so resting order
+        priority is based first on price level and then on order entry time.  When
+        an resting order is executed, it must be the first in the FIFO queue.  This
+        fact may be used as [additional] data integrity check within the Feedhandler
+        - if OrderExecuted is received for an order which is not at the top price
+        level, or is on the top price level but is not front of the FIFO queue - it
+        indicates a data itegrity issue.
 
-            Additional notes:
+        In total, there are about 40 thousand OrderExecuted messages for the day.
+        */
 
-            In theory, new instruments may be added intra-day and their instrument
-            definitions will be distributed via this message - but in practice this does
-            not happen.  So there is no need to continuously listen to instrument
-            definitions.  Mostly likely, these would be used just once to get instrument
-            descriptions - in approximately one minute all definitions can be received.
-            Or even more likely, the client system would already have all definitions
-            built by a different component and stored in e.g. configuration file; in
-            that case these messages can be completely ignored.
-            */
+        stamp(m.TimeOffset, context);
+        m_obm.execute_order<Policy>(m.OrderId, m.ExecutedQuantity);
+    }
 
-            FuturesInstrumentDefinition m = *(FuturesInstrumentDefinition*)message;
-            Symbol symbol(m.Symbol);
+    void on(const ReduceSizeLong& m, const MessageContext& context)
+    {
+        reduce(m, context);
+    }
 
-            m_obm.add_orderbook(symbol, m.ContractSize, m.PriceIncrement);
-            // Pass the symbol to the data exporter for conversion to human-readable symbol
-            m_dataExporter.symbol_tostring(symbol, m, message);
-            break;
-        }
+    void on(const ReduceSizeShort& m, const MessageContext& context)
+    {
+        /*
+        From the CFE PITCH Spec:
 
-        case 0xBE: // PriceLimits
-        {
-            /*
-            From the CFE PITCH Spec:
+        "Reduce Size messages are sent when a visible order on the CFE book is
+        partially reduced."
 
-            "The Price Limits message is sent out at the start of a session for products
-            subject to price limits per the contract specifications. The Price Limits
-            message does not signal whether price limits are in effect for that symbol;
-            it simply provides those values for when they are in effect. If multiple
-            Price Limits messages are received for the same Symbol, the most recent
-            values will override the previous values."
+        Additional notes:
 
-            Additional notes:
+        Note that the spec says "partially reduced" - so these are sent only when
+        there is an order remainder of at least 1, for example, order quantity is
+        reduced from 7 to 1, and price remains the same.  On CFE, it is possible to
+        send a "modify" request reducing the quantity to zero, but in that case CFE
+        sends a "DeleteOrder" message rather than reduce.
 
-            In practice, price limits are so wide that no CFE instrument has reached its
-            price limits ever in the entire history of trading.  So these are of
-            questionable value.  They can also be trivially calculated based on the
-            prior closing price.  Nevertheless, these may be used to e.g. visualize the
-            limits on the client GUI.
-            */
+        Similar to other Long/Short message flavors, ReduceSize is almost always
+        ReduceSizeShort; in the reference file there are no ReduceSizeLong messages.
+        However, there are no guarantees that CFE does not decide to send a
+        ReduceSizeLong just for the fun of it, so both must be processed.
 
-            // PriceLimits m = *(PriceLimits*)message;
-            break;
-        }
+        There are about 30 thousand ReduceSize messages in the reference MD file.
+        */
 
-        case 0xBC: // TransactionBegin
-        {
-            /*
-            From the CFE PITCH Spec:
-
-            "The Transaction Begin message indicates any subsequent messages, up to the
-            accompanying Transaction End message, are all part of the same transaction
-            block. One example of where this might be used is when a single aggressive
-            order executes against several resting orders. All PITCH messages
-            corresponding to such an event would be included between a Transaction Begin
-            and Transaction End. It is important to note that any PITCH Message Type may
-            be included in a transaction block and there is no guarantee that the
-            messages apply to the same price level or even the same Symbol. Transaction
-            Begin messages do not alter the book and can be ignored if messages are
-            being used solely to build a book. Feed processors can use a transaction
-            block as a trigger to postpone publishing a quote update until the end of
-            the transaction block. In the prior example of a single aggressive order
-            executing against multiple resting orders, a top of book feed would be able
-            to publish a single trade message and quote update resulting from multiple
-            Order Executed messages once it finished processing all of the messages
-            within the transaction block."
-
-            Additional notes:
-
-            In practice, messages included in the TransactionBegin-TransactionEnd block
-            are almost always OrderExecuted which result from one large agressor
-            executing against multiple smaller resting orders - the same example as used
-            in the CFE PITCH spec.  This is really a *single* match event, but due to
-            system design CFE published it as multiple events - one per resting order -
-            all with the same Exchange timestamp.  In practice number of messages is
-            often 10 to 20 but may also reach 100 or more.  Feedhandler should
-            definitely avoid publishing updates to clients before it completes
-            processing of a transaction block.
-            */
-
-            // TransactionBegin m = *(TransactionBegin*)message;
-            break;
-        }
+        reduce(m, context);
+    }
 
-        case 0xBD: // TransactionEnd
-        {
-            /*
-            See comments for TransactionBegin.
-            */
+    void on(const ModifyOrderLong& m, const MessageContext& context)
+    {
+        modify(m, context);
+    }
 
-            // TransactionEnd m = *(TransactionEnd*)message;
-            break;
-        }
+    void on(const ModifyOrderShort& m, const MessageContext& context)
+    {
+        /*
+        From the CFE PITCH Spec:
 
-        case 0x31: // TradingStatus
-        {
-            /*
-            From the CFE PITCH Spec:
+        "The Modify Order message is sent whenever an open order is visibly
+        modified. The Order Id refers to the Order Id of the original Add Order
+        message.  Note that Modify Order messages that appear to be “no ops” (i.e.
+        they do not appear to modify any relevant fields) will still lose priority."
 
-            "The Trading Status message is used to indicate the current trading status
-            of a Futures contract. A Trading Status message will be sent whenever a
-            security’s trading status changes. If a Trading Status has not been received
-            for a symbol, then the Trading Status for the symbol should be assumed to be
-            “S = Suspended”."
+        Additional notes:
 
-            Additional notes:
+        Similar to other Long/Short messages flavors, almost all modifies are
+        ModifyOrderShort - there are about 360 thousand of them in the reference MD
+        file.  But ModifyOrderLong should also be handled, and there is in fact 1 of
+        those in the reference file.
 
-            These are sent for every instrument - both simple and complex (spreads).  In
-            general:
-            - Around 16:45 Central Time, instruments transition to "Q - Queing";
-            orders can be added but no trading yet
-            - Around 17:00 Central Time, instruments transition to "T - Trading";
-            trading is enabled
-            - Around 16:00 Central Time (next day), instruments transition to "S -
-            Suspended"; trading is closed
+        ModifyOrder represent the most complex message for book-building purposes.
+        Note that ModifyOrder may modify an order's (1) price only, (2) quantity
+        only, (3) both price and quantity, or (4) nothing.  Case (4) is a "no-op
+        modify" mentioned in the CFE spec and results in order being sent to the end
+        of the FIFO queue.
+        */
 
-            Note that some low-liquidity instruments, like exotic spreads or far-out
-            outrights, may transition between Q and T also at seemingly random time
-            during the trading day.
-            */
+        modify(m, context);
+    }
 
-            TradingStatus m = *(TradingStatus*)message;
-            m_obm.update_tradingStatus(m.Symbol, m.TradingStatus);
-            break;
-        }
+    void on(const DeleteOrder& m, const MessageContext& context)
+    {
+        /*
+        From the CFE PITCH Spec:
 
-        case 0x2A: // TradeLong
-        {
-            // TradeLong m = *(TradeLong*)message;
-            break;
-        }
-        case 0x2B: // TradeShort
-        {
-            /*
-            From the CFE PITCH Spec:
+        "The Delete Order message is sent whenever a booked order is cancelled or
+        leaves the order book. The Order Id refers to the Order Id of the original
+        Add Order message. An order that is deleted from the book may return to the
+        book later under certain circumstances. Therefore, a Delete Order message
+        does not indicate that a given Order Id will not be sent again on a
+        subsequent Add Order message."
 
-            "The Trade message provides information about executions that occur off of
-            the CFE book (such as ECRP/Block trades). Trade messages are necessary to
-            calculate CFE execution data. Trade messages do not alter the book and can
-            be ignored if messages are being used solely to build a book. The Order Id
-            sent in a Trade message is obfuscated and will not tie back to any real
-            Order Id sent back via a FIX or BOE order entry session."
+        Additional notes:
 
-            Additional notes:
+        Note the second part of the above comment from PITCH spec - deleted order
+        may return to the book under certain conditions.  This means that the same
+        Order ID may be used *again* following the delete.  So, while Ordder IDs are
+        unique among outstanding orders, they are not globally unique.
 
-            Most commonly, TradeLong/TradeShort messages are sent when a spread
-            instrument trades.  CFE sends OrderExecuted for the spread itself, and
-            TradeLong/TradeShort for each of the legs.  As noted in the Spec, these can
-            be ignored for the purposes of book-building because the actual book which
-            trades is the spread book, not the legs. They may be useful for some other
-            purposes like calculating leg trading volume.  When these are sent, almost
-            always they are TradeShort and not TradeLong.
-            */
+        DeleteOrder is the second-most common message after AddOrder, with about 670
+        thousand DeleteOrder messages in the reference file.
+        */
 
-            // TradeShort m = *(TradeShort*)message;
-            break;
-        }
+        stamp(m.TimeOffset, context);
+        m_obm.cancel_order<Policy>(m.OrderId);
+    }
 
-        case 0x2C: // TradeBreak
-        {
-            /*
-            From the CFE PITCH Spec:
+private:
+    // BBO records of an order message carry its time and position in the feed
+    void stamp(uint32_t timeOffset, const MessageContext& context) noexcept
+    {
+        m_dataExporter.set_message_infos(timeOffset, context.pktSeqNum, context.msgSeqNum);
+    }
 
-            "The Trade Break message is sent whenever an execution on CFE is broken.
-            Trade breaks are rare and only affect applications that rely upon CFE
-            execution-based data. A Trade Break followed immediately be a new Trade with
-            the same Execution Id indicates that a trade correction has occurred.
-            Applications that simply build a CFE book can ignore Trade Break messages."
+    template<typename AddOrder>
+    void add(const AddOrder& m, const MessageContext& context)
+    {
+        Order::Side side = m.SideIndicator == 'B' ? Order::Side::Buy : Order::Side::Sell;
+        stamp(m.TimeOffset, context);
+        m_obm.add_order<Policy>(m.OrderId, m.Symbol, m.Price, m.Quantity, side);
+    }
 
-            Additional notes:
+    template<typename ReduceSize>
+    void reduce(const ReduceSize& m, const MessageContext& context)
+    {
+        stamp(m.TimeOffset, context);
+        m_obm.reduce_order<Policy>(m.OrderId, m.CancelledQuantity);
+    }
 
-            As noted, these are rare.  There are none in the reference market data file
-            for trade date 2023-11-16.
-            */
+    template<typename ModifyOrder>
+    void modify(const ModifyOrder& m, const MessageContext& context)
+    {
+        stamp(m.TimeOffset, context);
+        m_obm.modify_order<Policy>(m.OrderId, m.Price, m.Quantity);
+    }
 
-            // TradeBreak m = *(TradeBreak*)message;
-            break;
-        }
+private:
+    OrderBookManager& m_obm;
+    DataExporter& m_dataExporter;
+};
 
-        case 0xB9: // Settlement
-        {
-            /*
-            From the CFE PITCH Spec:
+// Writes the event log of a day parsed from the capture (--eventLog). Runs after the BookBuilder, whose books it
+// looks the symbols up in.
+class CBOEPcapParser::EventLogRecorder
+{
+public:
+    EventLogRecorder(EventLogWriter& log, const OrderBookManager& obm) noexcept
+        : m_log{log}, m_obm{obm}
+    {
+    }
 
-            "Settlement messages are used to provide information concerning indicative,
-            approved, or corrected daily and final settlement prices for CFE products.
-            An indicative daily settlement price (Issue = I) is calculated by the system
-            and sent immediately after an instrument closes trading but before the
-            settlement price is approved. An approved settlement price (Issue = S) is
-            sent once the CFE Trade Desk approves a settlement price for an instrument.
-            If there is an error in the approved settlement price, then it may be
-            re-issued (Issue = R). For symbols that settle each day using VWAP, the
-            system will begin disseminating an intermediate indicative price update
-            (Issue = i) at 2:59:35 p.m. CT (following the first interval of the VWAP
-            calculation) that will be sent every five seconds, leading up to the receipt
-            of the indicative daily settlement price (Issue = I)."
+    void on(const Time& m, const MessageContext& context)
+    {
+        append({.orderId = m.Time, .type = L3EventType::Time}, context, 0);
+    }
 
-            Additional notes:
+    void on(const TimeReference& m, const MessageContext& context)
+    {
+        append({.orderId = m.MidnightReference, .type = L3EventType::Date}, context, 0);
+    }
 
-            Typically these are informational-only but there may be a trading strategy
-            client interested in the indicative settlement prices.  Thus, a Feedhandler
-            may want to forward these to clients.
-            */
+    void on(const FuturesInstrumentDefinition& m, const MessageContext& context)
+    {
+        m_log.append_instrument(*m_obm.find_book(m.Symbol), reinterpret_cast<const u_char*>(&m), context.length - sizeof(MessageHeader),
+                                context.pktSeqNum, context.msgSeqNum, m.TimeOffset);
+    }
 
-            // Settlement m = *(Settlement*)message;
-            break;
-        }
+    void on(const TransactionBegin& m, const MessageContext& context)
+    {
+        append({.type = L3EventType::TransactionBegin}, context, m.TimeOffset);
+    }
 
-        case 0xD3: // OpenInterest
-        {
-            /*
-            From the CFE PITCH Spec:
+    void on(const TransactionEnd& m, const MessageContext& context)
+    {
+        append({.type = L3EventType::TransactionEnd}, context, m.TimeOffset);
+    }
 
-            "The Open Interest message is sent to communicate a symbol’s open interest,
-            usually for the prior trading date. This message will be sent when open
-            interest information is made available to CFE and may be sent multiple times
-            if there are changes to the open interest for a symbol. The open interest is
-            also populated in the End of Day Summary message."
+    void on(const TradingStatus& m, const MessageContext& context)
+    {
+        append({.book = m_obm.find_book(m.Symbol).value_or(L3Event::NoBook), .type = L3EventType::Status, .flag = m.TradingStatus},
+               context, m.TimeOffset);
+    }
 
-            Additional notes:
+    template<typename Trade>
+        requires std::same_as<Trade, TradeLong> || std::same_as<Trade, TradeShort>
+    void on(const Trade& m, const MessageContext& context)
+    {
+        append({.orderId = m.OrderId, .price = m.Price, .quantity = m.Quantity,
+                .book = m_obm.find_book(m.Symbol).value_or(L3Event::NoBook), .type = L3EventType::Trade,
+                .flag = m.SideIndicator}, context, m.TimeOffset);
+    }
 
-            Most likely these are informational-only.  Maybe a client may want to store
-            these daily values into the database for some later analysis.  These may
-            usually be obtained from other sources, also.
-            */
+    template<typename AddOrder>
+        requires std::same_as<AddOrder, AddOrderLong> || std::same_as<AddOrder, AddOrderShort>
+    void on(const AddOrder& m, const MessageContext& context)
+    {
+        // The book is resolved already: the add succeeded
+        append({.orderId = m.OrderId, .price = m.Price, .quantity = m.Quantity, .book = *m_obm.find_book(m.Symbol),
+                .type = L3EventType::Add, .flag = m.SideIndicator}, context, m.TimeOffset);
+    }
 
-            // OpenInterest m = *(OpenInterest*)message;
-            break;
-        }
+    void on(const OrderExecuted& m, const MessageContext& context)
+    {
+        append({.orderId = m.OrderId, .quantity = m.ExecutedQuantity, .type = L3EventType::Execute}, context, m.TimeOffset);
+    }
 
-        case 0xBA: // EndOfDaySummary
-        {
-            /*
-            From the CFE PITCH Spec:
+    template<typename ReduceSize>
+        requires std::same_as<ReduceSize, ReduceSizeLong> || std::same_as<ReduceSize, ReduceSizeShort>
+    void on(const ReduceSize& m, const MessageContext& context)
+    {
+        append({.orderId = m.OrderId, .quantity = m.CancelledQuantity, .type = L3EventType::Reduce}, context, m.TimeOffset);
+    }
 
-            "The End of Day Summary is sent immediately after trading ends for a symbol.
-            No more Market Update messages will follow an End of Day Summary for a
-            particular symbol. A value of zero in the Total Volume field means that no
-            volume traded on that symbol for the day. The Total Volume field reflects
-            all contracts traded during the day. Block, ECRP, and Derived (effective
-            12/11/23) trades are included in the Total Volume field, but they are also
-            reported separately to provide more detail.""
+    template<typename ModifyOrder>
+        requires std::same_as<ModifyOrder, ModifyOrderLong> || std::same_as<ModifyOrder, ModifyOrderShort>
+    void on(const ModifyOrder& m, const MessageContext& context)
+    {
+        append({.orderId = m.OrderId, .price = m.Price, .quantity = m.Quantity, .type = L3EventType::Modify}, context, m.TimeOffset);
+    }
 
-            Additional notes:
+    void on(const DeleteOrder& m, const MessageContext& context)
+    {
+        append({.orderId = m.OrderId, .type = L3EventType::Delete}, context, m.TimeOffset);
+    }
 
-            Similar to OpenInterest, these would most likely be informational-only.  May
-            be useful to store daily values to some database.
-            */
+private:
+    void append(const L3Event& event, const MessageContext& context, uint32_t timeOffset)
+    {
+        m_log.append(event, context.pktSeqNum, context.msgSeqNum, timeOffset);
+    }
 
-            // EndOfDaySummary m = *(EndOfDaySummary*)message;
-            break;
-        }
+private:
+    EventLogWriter& m_log;
+    const OrderBookManager& m_obm;
+};
 
-        case 0x2D: // EndOfSession
-        {
-            /*
-            From the CFE PITCH Spec:
+// Decode stage of --pipeline and --shards: emit(event, pktSeqNum, msgSeqNum, timeOffset, definition, size) for
+// every message that matters to the books, the same events as the EventLogRecorder writes. Book indices are
+// the ones the book stage gives: the order of the first definitions, as in OrderBookManager::add_orderbook.
+template<typename Emit>
+class CBOEPcapParser::EventDecoder
+{
+public:
+    explicit EventDecoder(Emit& emit) noexcept
+        : m_emit{emit}, m_books{}
+    {
+    }
 
-            "The End of Session message is sent for each unit when the unit shuts down.
-            No more sequenced messages will be delivered for this unit, but heartbeats
-            from the unit may be received."
+    void on(const Time& m, const MessageContext& context)
+    {
+        event({.orderId = m.Time, .type = L3EventType::Time}, context, 0);
+    }
 
-            Additional notes:
+    void on(const TimeReference& m, const MessageContext& context)
+    {
+        event({.orderId = m.MidnightReference, .type = L3EventType::Date}, context, 0);
+    }
 
-            Very last sequenced message on the feed.  Probably not very useful and can
-            be ignored, since it's pretty clear when things shut down based on other
-            data.  Perhaps could be used to double-check data integrity by verifying that
-            it is indeed the last message.
-            */
+    void on(const FuturesInstrumentDefinition& m, const MessageContext& context)
+    {
+        m_emit(L3Event{.book = book(m.Symbol, true), .type = L3EventType::Instrument}, context.pktSeqNum, context.msgSeqNum,
+               m.TimeOffset, reinterpret_cast<const u_char*>(&m), context.length - sizeof(MessageHeader));
+    }
 
-            // EndOfSession m = *(EndOfSession*)message;
-            break;
+    void on(const TransactionBegin& m, const MessageContext& context)
+    {
+        event({.type = L3EventType::TransactionBegin}, context, m.TimeOffset);
+    }
+
+    void on(const TransactionEnd& m, const MessageContext& context)
+    {
+        event({.type = L3EventType::TransactionEnd}, context, m.TimeOffset);
+    }
+
+    void on(const TradingStatus& m, const MessageContext& context)
+    {
+        event({.book = book(m.Symbol), .type = L3EventType::Status, .flag = m.TradingStatus}, context, m.TimeOffset);
+    }
+
+    template<typename Trade>
+        requires std::same_as<Trade, TradeLong> || std::same_as<Trade, TradeShort>
+    void on(const Trade& m, const MessageContext& context)
+    {
+        event({.orderId = m.OrderId, .price = m.Price, .quantity = m.Quantity, .book = book(m.Symbol),
+               .type = L3EventType::Trade, .flag = m.SideIndicator}, context, m.TimeOffset);
+    }
+
+    template<typename AddOrder>
+        requires std::same_as<AddOrder, AddOrderLong> || std::same_as<AddOrder, AddOrderShort>
+    void on(const AddOrder& m, const MessageContext& context)
+    {
+        event({.orderId = m.OrderId, .price = m.Price, .quantity = m.Quantity, .book = book(m.Symbol),
+               .type = L3EventType::Add, .flag = m.SideIndicator}, context, m.TimeOffset);
+    }
+
+    void on(const OrderExecuted& m, const MessageContext& context)
+    {
+        event({.orderId = m.OrderId, .quantity = m.ExecutedQuantity, .type = L3EventType::Execute}, context, m.TimeOffset);
+    }
+
+    template<typename ReduceSize>
+        requires std::same_as<ReduceSize, ReduceSizeLong> || std::same_as<ReduceSize, ReduceSizeShort>
+    void on(const ReduceSize& m, const MessageContext& context)
+    {
+        event({.orderId = m.OrderId, .quantity = m.CancelledQuantity, .type = L3EventType::Reduce}, context, m.TimeOffset);
+    }
+
+    template<typename ModifyOrder>
+        requires std::same_as<ModifyOrder, ModifyOrderLong> || std::same_as<ModifyOrder, ModifyOrderShort>
+    void on(const ModifyOrder& m, const MessageContext& context)
+    {
+        event({.orderId = m.OrderId, .price = m.Price, .quantity = m.Quantity, .type = L3EventType::Modify}, context, m.TimeOffset);
+    }
+
+    void on(const DeleteOrder& m, const MessageContext& context)
+    {
+        event({.orderId = m.OrderId, .type = L3EventType::Delete}, context, m.TimeOffset);
+    }
+
+private:
+    void event(const L3Event& e, const MessageContext& context, uint32_t timeOffset)
+    {
+        m_emit(e, context.pktSeqNum, context.msgSeqNum, timeOffset, nullptr, 0);
+    }
+
+    // L3Event::NoBook for a symbol never defined, unless define is set
+    Order::BookIndex book(const Symbol& symbol, bool define = false)
+    {
+        auto it = std::ranges::lower_bound(m_books, symbol.key(), {}, &std::pair<uint64_t, Order::BookIndex>::first);
+        if (it != m_books.end() && it->first == symbol.key())
+            return it->second;
+        if (!define)
+            return L3Event::NoBook;
+
+        auto index = static_cast<Order::BookIndex>(m_books.size());
+        m_books.insert(it, {symbol.key(), index});
+        return index;
+    }
+
+private:
+    Emit& m_emit;
+    std::vector<std::pair<uint64_t, Order::BookIndex>> m_books; // (Symbol::key(), book index) sorted by key
+};
+
+// --gaps
+class CBOEPcapParser::GapChecker
+{
+public:
+    explicit GapChecker(MessageInfo& messageInfo) noexcept
+        : m_messageInfo{messageInfo}
+    {
+    }
+
+    void on_packet(const SequencedUnitHeader& suHeader)
+    {
+        // Gap detection
+        if (m_messageInfo.gNextExpectedPacketSeqNum)
+        {
+            if (suHeader.HdrSequence != m_messageInfo.gNextExpectedPacketSeqNum && suHeader.HdrSequence != 1)
+            {
+                unsigned int hdrSeq = suHeader.HdrSequence;
+                m_messageInfo.packet_gaps.push_back({m_messageInfo.gNextExpectedPacketSeqNum, hdrSeq});
+            }
         }
+        m_messageInfo.gNextExpectedPacketSeqNum = suHeader.HdrSequence + suHeader.HdrCount;
+    }
 
-        // ORDER MESSAGES
-        // The following messages do alter book state.  In order to correctly build
-        // order books and maintain data integrity, it is essential to process every
-        // message correctly.  Even a single missed message will likely result in
-        // loss of data integrity.  Appropriate checks may and should be used in
-        // code.  For instance, all of OrderExecuted, ReduceSize, ModifyOrder, and
-        // DeleteOrder messages refer to the OrderId of an order which must exist;
-        // if Feedhandler is not able to find such OrderId it most likely means that
-        // it has missed on incorrectly processed some earlier message(s).
-        // OrderExecuted should only occur to orders at the top of the FIFO queue,
-        // and so on.  It is recommended that Feedhandler implements data integrity
-        // checks whether in a form of asserts, exceptions, or log messages -
-        // especially during the development stages while the code is not yet
-        // proven.
-
-        case 0x21: // AddOrderLong
-        {
-            AddOrderLong m = *(AddOrderLong *)message;
-            Order::Side side = m.SideIndicator == 'B' ? Order::Side::Buy : Order::Side::Sell;
-            m_dataExporter.set_time_offset(m.TimeOffset);
-            m_dataExporter.set_packet_infos(pktSeqNum, msgSeqNum);
-
-            m_obm.add_order(m.OrderId, m.Symbol, m.Price, m.Quantity, side);
-            break;
+private:
+    MessageInfo& m_messageInfo;
+};
+
+// --msgSummary: messages by trade date and type, unknown types included
+class CBOEPcapParser::MessageCounter
+{
+public:
+    explicit MessageCounter(MessageInfo& messageInfo) noexcept
+        : m_messageInfo{messageInfo}
+    {
+    }
+
+    void on_message(const MessageContext& context)
+    {
+        m_messageInfo.totalMessages++;
+        m_messageInfo.messageCounts[context.type]++;
+        m_messageInfo.dailyMessageCounts[m_messageInfo.currentTradeDay][context.type]++;
+    }
+
+    // Counted under the date it starts
+    void on(const TimeReference& m, const MessageContext&)
+    {
+        m_messageInfo.set_trade_date(m.TradeDate);
+    }
+
+private:
+    MessageInfo& m_messageInfo;
+};
+
+// --singlePass: a day starts where the sequence numbers go back, as with PcapSlicer::daily_scan. Each day is built by
+// a parser of its own, whose exporter writes out its files as soon as the next day starts.
+template<typename Policy>
+class CBOEPcapParser::DaySplitter
+{
+public:
+    DaySplitter(const std::string& filename, std::size_t firstDay)
+        : m_filename{filename}, m_firstDay{firstDay}, m_dayCount{0}, m_nextExpectedPacketSeqNum{0}, m_day{}, m_books{}, m_sw{}
+    {
+    }
+    DaySplitter(const DaySplitter&) = delete;
+    DaySplitter& operator=(const DaySplitter&) = delete;
+
+    void on_packet(const SequencedUnitHeader& suHeader)
+    {
+        // Sequence numbers are reset to 1 at every feed startup, gaps inside a day do not split it
+        if (!m_day || suHeader.HdrSequence < m_nextExpectedPacketSeqNum)
+        {
+            next_day();
         }
-        case 0x22: // AddOrderShort
-        {
-            /*
-            From the CFE PITCH Spec:
-
-            "An Add Order message represents a newly accepted visible order on the CFE
-            book. It includes a day-specific Order Id assigned by CFE to the order."
-
-            Additional notes:
-
-            AddOrderLong/AddOrderShort is what adds orders to the books.  In the
-            reference market data file, there are about 700 thousand AddOrder messages.
-            Almost all of them are AddOrderShort - but once in a while CFE sends
-            AddOrderLong to keep things interesting, so it cannot be ignored.  It may be
-            useful to process these two together as a single message type to avoid code
-            duplication.
-
-            The first AddOrder messages for the day are typically sent around 16:07.
-            These are GTC orders that are left in books being restored.  There's usually
-            about 15 thousand GTC orders.  In order to maintain data integrity, it is
-            essential to listen to these GTC-restoring day orders or have them in PCAP.
-            Thus, a full day PCAP should start prior to this approximately 16:07 time.
-            All GTC-restoring AddOrder messages have the same Exchange timestamp and are
-            sent closely together, possibly at the maximum line rate of 10 Gbps.  Thus,
-            15 thousand or so messages may be received during a single millisecond
-            creating one of the peak daily load spikes.  It is, of course, important
-            that a Feedhandler is able to process this spike and does not drop any of
-            these messages.
-
-            It may be important for client strategies to know whether orders are GTC or
-            not.  So a Feedhandler may want to mark orders added during this
-            GTC-restoration cycle as GTC, as opposed to DAY orders added later.
-
-            In total, there are about 700 thousand AddOrder messages for the day.
-            */
-            AddOrderShort m = *(AddOrderShort *)message;
-            Order::Side side = m.SideIndicator == 'B' ? Order::Side::Buy : Order::Side::Sell;
-            m_dataExporter.set_time_offset(m.TimeOffset);
-            m_dataExporter.set_packet_infos(pktSeqNum, msgSeqNum);
-
-            m_obm.add_order(m.OrderId, m.Symbol, m.Price, m.Quantity, side);
-            break;
+        m_nextExpectedPacketSeqNum = suHeader.HdrSequence + suHeader.HdrCount;
+    }
+
+    // The messages the books take go to those of the current day
+    template<typename Message>
+        requires requires(BookBuilder<Policy>& books, const Message& m, const MessageContext& context) { books.on(m, context); }
+    void on(const Message& m, const MessageContext& context)
+    {
+        m_books->on(m, context);
+    }
+
+    // Closes the current day
+    void finish_day()
+    {
+        if (!m_day)
+            return;
+
+        m_books.reset();
+        auto day = std::move(m_day);
+        day->m_obm.finish();
+        day->m_dataExporter.finish();
+
+        m_sw.Stop();
+        if (Config::getInstance().time())
+            m_sw.display_time();
+    }
+
+    CBOEPcapParser* day() noexcept { return m_day.get(); }     // nullptr before the first packet
+    std::size_t days() const noexcept { return m_dayCount; }
+
+private:
+    void next_day()
+    {
+        finish_day();
+
+        auto& config = Config::getInstance();
+        std::size_t id = m_firstDay + m_dayCount++;
+        if (config.time())
+        {
+            m_sw.Reset();
+            m_sw.set_name("Day " + std::to_string(id) + " Time");
+            m_sw.Start();
         }
 
-        case 0x23: // OrderExecuted
+        m_day = std::make_unique<CBOEPcapParser>(m_filename, id);
+        m_day->m_orderstore.reserve(config.orderCapacity());
+        m_books.emplace(m_day->m_obm, m_day->m_dataExporter);
+    }
+
+private:
+    std::string m_filename;
+    std::size_t m_firstDay;
+    std::size_t m_dayCount;
+    uint64_t m_nextExpectedPacketSeqNum;
+    std::unique_ptr<CBOEPcapParser> m_day;
+    std::optional<BookBuilder<Policy>> m_books;     // Declared after the day it builds the books of
+    StopWatch m_sw;
+};
+
+template<typename Callback>
+void CBOEPcapParser::for_each_packet(Callback&& callback)
+{
+    if (Config::getInstance().mmap() || m_range)
+    {
+        // Zero-copy path: packets are handed out as pointers into the file mapping
+        MmapPcapReader reader(m_pcapFilename);
+        PcapRecord record;
+
+        if (m_range)
+            reader.set_range(m_range->begin, m_range->end);
+
+        while (reader.next(record))
         {
-            /*
-            From the CFE PITCH Spec:
+            callback(record.data);
+        }
+        return;
+    }
 
-            "Order Executed messages are sent when an order on the CFE book is executed
-            in whole or in part. The execution price equals the limit order price found
-            in the original Add Order message or the limit order price in the latest
-            Modify Order message referencing the Order Id."
+    char errbuf[PCAP_ERRBUF_SIZE];  // Buffer to store error messages
+    pcap_t* pcap;                   // PCAP handle
+    struct pcap_pkthdr header; // Header for packet metadata
+    const u_char* packet;      // Pointer to the packet data
 
-            Additional notes:
+    // Attempt to open the provided PCAP file in offline mode
+    pcap = pcap_open_offline(m_pcapFilename.c_str(), errbuf);
+    if (pcap == nullptr) 
+    {
+        throw std::runtime_error("Error: Unable to open the file " + m_pcapFilename);
+    }
 
-            CFE is strictly a First-In-First-Out (FIFO) market, so resting order
-            priority is based first on price level and then on order entry time.  When
-            an resting order is executed, it must be the first in the FIFO queue.  This
-            fact may be used as [additional] data integrity check within the Feedhandler
-            - if OrderExecuted is received for an order which is not at the top price
-            level, or is on the top price level but is not front of the FIFO queue - it
-            indicates a data itegrity issue.
+    while ((packet = pcap_next(pcap, &header)) != nullptr) 
+    {
+        callback(packet);
+    }
 
-            In total, there are about 40 thousand OrderExecuted messages for the day.
-            */
+    // Close the PCAP file
+    pcap_close(pcap);
+}
 
-            OrderExecuted m = *(OrderExecuted*)message;
-            m_dataExporter.set_time_offset(m.TimeOffset);
-            m_dataExporter.set_packet_infos(pktSeqNum, msgSeqNum);
+template<typename Policy>
+void CBOEPcapParser::parse()
+{
+    auto& config = Config::getInstance();
 
-            m_obm.execute_order(m.OrderId, m.ExecutedQuantity);
-            break;
-        }
+    auto run = [&](auto&... sinks)
+    {
+        MessageDispatcher dispatcher{sinks...};
 
-        case 0x25: // ReduceSizeLong
+        // Process each packet in the PCAP file
+        for_each_packet([&](const u_char* packet)
         {
-            ReduceSizeLong m = *(ReduceSizeLong *)message;
-            m_dataExporter.set_time_offset(m.TimeOffset);
-            m_dataExporter.set_packet_infos(pktSeqNum, msgSeqNum);
+            dispatcher.packet(packet);
+
+            if (config.showOB())
+                show_orderbook();
+        });
+        report_skipped(dispatcher.skipped());
+    };
+
+    BookBuilder<Policy> books{m_obm, m_dataExporter};
+    if (m_eventLog.is_open())
+    {
+        EventLogRecorder recorder{m_eventLog, m_obm};
+        run(books, recorder);
+    }
+    else
+    {
+        run(books);
+    }
+    m_obm.finish();
+}
 
-            m_obm.reduce_order(m.OrderId, m.CancelledQuantity);
+template<typename Policy>
+void CBOEPcapParser::apply_event(const L3Event& e, EventClock& clock, const u_char* definition, OrderBookManager& obm, DataExporter& dataExporter)
+{
+    // Order events only carry the offset into the current second to the exporter
+    uint64_t msgSeqNum = uint64_t{e.pktSeqNum} + e.msgIndex;
+    uint32_t timeOffset = clock.advance(e);
+    switch (e.type)
+    {
+        case L3EventType::Date:
+            dataExporter.set_date(static_cast<std::time_t>(e.orderId));
             break;
-        }
-        case 0x26: // ReduceSizeShort
+        case L3EventType::Time:
+            dataExporter.set_time_ref(static_cast<uint32_t>(e.orderId));
+            break;
+        case L3EventType::Instrument:
+            if (define_instrument(definition, obm, dataExporter) != e.book)
+                throw std::runtime_error("Error: the decoded events do not match the order books they rebuild");
+            break;
+        case L3EventType::Add:
+            dataExporter.set_message_infos(timeOffset, e.pktSeqNum, msgSeqNum);
+            obm.add_order<Policy>(e.orderId, e.book, e.price, static_cast<Order::Quantity>(e.quantity),
+                                    e.flag == 'B' ? Order::Side::Buy : Order::Side::Sell);
+            break;
+        case L3EventType::Delete:
+            dataExporter.set_message_infos(timeOffset, e.pktSeqNum, msgSeqNum);
+            obm.cancel_order<Policy>(e.orderId);
+            break;
+        case L3EventType::Modify:
+            dataExporter.set_message_infos(timeOffset, e.pktSeqNum, msgSeqNum);
+            obm.modify_order<Policy>(e.orderId, e.price, static_cast<Order::Quantity>(e.quantity));
+            break;
+        case L3EventType::Reduce:
+            dataExporter.set_message_infos(timeOffset, e.pktSeqNum, msgSeqNum);
+            obm.reduce_order<Policy>(e.orderId, static_cast<Order::Quantity>(e.quantity));
+            break;
+        case L3EventType::Execute:
+            dataExporter.set_message_infos(timeOffset, e.pktSeqNum, msgSeqNum);
+            obm.execute_order<Policy>(e.orderId, static_cast<Order::Quantity>(e.quantity));
+            break;
+        case L3EventType::Trade:
+            break; // Off book, the BookBuilder ignores TradeLong/TradeShort
+        case L3EventType::Status:
+            obm.update_tradingStatus(e.book, e.flag);
+            break;
+        case L3EventType::TransactionBegin:
+            obm.begin_transaction();
+            break;
+        case L3EventType::TransactionEnd:
+            dataExporter.set_message_infos(timeOffset, e.pktSeqNum, msgSeqNum);
+            obm.end_transaction();
+            break;
+    }
+}
+
+template<typename Policy>
+void CBOEPcapParser::replay(const EventLogReader& log)
+{
+    bool showOB = Config::getInstance().showOB();
+    EventClock clock{};         // Same clock as EventLogWriter
+    uint32_t packet = 0;
+
+    for (const L3Event& e : log.events())
+    {
+        // --showOB looks at the books once per packet, as parse() does
+        if (showOB && e.pktSeqNum != packet)
         {
-            /*
-            From the CFE PITCH Spec:
+            show_orderbook();
+            packet = e.pktSeqNum;
+        }
 
-            "Reduce Size messages are sent when a visible order on the CFE book is
-            partially reduced."
+        apply_event<Policy>(e, clock, e.type == L3EventType::Instrument ? log.definition(e).data() : nullptr, m_obm, m_dataExporter);
+    }
+    m_obm.finish();
+    if (showOB)
+        show_orderbook();
 
-            Additional notes:
+    m_replayedEvents = log.events().size();
+}
+
+CBOEPcapParser::PipelineEvent CBOEPcapParser::stage_event(L3Event event, EventClock& clock, uint64_t pktSeqNum, uint64_t msgSeqNum,
+                                                           uint32_t timeOffset, const u_char* definition, std::size_t size)
+{
+    if (m_eventLog.is_open())
+    {
+        if (definition)
+            m_eventLog.append_instrument(event.book, definition, size, pktSeqNum, msgSeqNum, timeOffset);
+        else
+            m_eventLog.append(event, pktSeqNum, msgSeqNum, timeOffset);
+    }
 
-            Note that the spec says "partially reduced" - so these are sent only when
-            there is an order remainder of at least 1, for example, order quantity is
-            reduced from 7 to 1, and price remains the same.  On CFE, it is possible to
-            send a "modify" request reducing the quantity to zero, but in that case CFE
-            sends a "DeleteOrder" message rather than reduce.
+    clock.stamp(event, pktSeqNum, msgSeqNum, timeOffset);
+    PipelineEvent decoded{event, nullptr};
+    if (definition)
+    {
+        // The packet is only valid until the next one with libpcap
+        decoded.definition = std::make_unique_for_overwrite<u_char[]>(size);
+        std::memcpy(decoded.definition.get(), definition, size);
+    }
+    return decoded;
+}
 
-            Similar to other Long/Short message flavors, ReduceSize is almost always
-            ReduceSizeShort; in the reference file there are no ReduceSizeLong messages.
-            However, there are no guarantees that CFE does not decide to send a
-            ReduceSizeLong just for the fun of it, so both must be processed.
+template<typename Policy>
+void CBOEPcapParser::pipeline()
+{
+    auto& config = Config::getInstance();
+    bool showOB = config.showOB();
 
-            There are about 30 thousand ReduceSize messages in the reference MD file.
-            */
+    m_eventRing = std::make_unique<SpscRing<PipelineEvent>>(config.ringSize());
+    if (config.bbo())
+        m_dataExporter.start_export_stage(config.ringSize());
 
-            ReduceSizeShort m = *(ReduceSizeShort *)message;
-            m_dataExporter.set_time_offset(m.TimeOffset);
-            m_dataExporter.set_packet_infos(pktSeqNum, msgSeqNum);
+    // Decode stage: packets to stamped L3Events, and the event log with --eventLog
+    std::exception_ptr decodeError;
+    std::thread decoder([&]
+    {
+        auto start = std::chrono::steady_clock::now();
+        try
+        {
+            EventClock clock{};
+            bool running = true; // Until the book stage stops taking events
+            auto emit = [&](L3Event event, uint64_t pktSeqNum, uint64_t msgSeqNum, uint32_t timeOffset,
+                            const u_char* definition, std::size_t size)
+            {
+                PipelineEvent decoded = stage_event(event, clock, pktSeqNum, msgSeqNum, timeOffset, definition, size);
+                running = running && m_eventRing->push(std::move(decoded));
+            };
+            EventDecoder decoder{emit};
+            MessageDispatcher dispatcher{decoder};
 
-            m_obm.reduce_order(m.OrderId, m.CancelledQuantity);
-            break;
+            for_each_packet([&](const u_char* packet)
+            {
+                if (running)
+                    dispatcher.packet(packet);
+            });
+            report_skipped(dispatcher.skipped());
         }
-
-        case 0x27: // ModifyOrderLong
+        catch (...)
         {
-            ModifyOrderLong m = *(ModifyOrderLong *)message;
-            m_dataExporter.set_time_offset(m.TimeOffset);
-            m_dataExporter.set_packet_infos(pktSeqNum, msgSeqNum);
+            decodeError = std::current_exception();
+        }
+        m_eventRing->close();
+        m_decodeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    });
 
-            m_obm.modify_order(m.OrderId, m.Price, m.Quantity);
+    // Book stage, on this thread: BBO updates go to the export stage through store_BBO_records
+    auto start = std::chrono::steady_clock::now();
+    try
+    {
+        EventClock clock{};
+        uint32_t packet = 0;
+        PipelineEvent decoded{};
+        while (m_eventRing->pop(decoded))
+        {
+            const L3Event& e = decoded.event;
+            // --showOB looks at the books once per packet, as parse() does
+            if (showOB && e.pktSeqNum != packet)
+            {
+                show_orderbook();
+                packet = e.pktSeqNum;
+            }
 
-            break;
+            apply_event<Policy>(e, clock, decoded.definition.get(), m_obm, m_dataExporter);
         }
-        case 0x28: // ModifyOrderShort
+        m_obm.finish();
+        if (showOB)
+            show_orderbook();
+    }
+    catch (...)
+    {
+        m_eventRing->cancel();
+        decoder.join();
+        try
         {
-            /*
-            From the CFE PITCH Spec:
-
-            "The Modify Order message is sent whenever an open order is visibly
-            modified. The Order Id refers to the Order Id of the original Add Order
-            message.  Note that Modify Order messages that appear to be “no ops” (i.e.
-            they do not appear to modify any relevant fields) will still lose priority."
-
-            Additional notes:
-
-            Similar to other Long/Short messages flavors, almost all modifies are
-            ModifyOrderShort - there are about 360 thousand of them in the reference MD
-            file.  But ModifyOrderLong should also be handled, and there is in fact 1 of
-            those in the reference file.
-
-            ModifyOrder represent the most complex message for book-building purposes.
-            Note that ModifyOrder may modify an order's (1) price only, (2) quantity
-            only, (3) both price and quantity, or (4) nothing.  Case (4) is a "no-op
-            modify" mentioned in the CFE spec and results in order being sent to the end
-            of the FIFO queue.
-            */
-
-            ModifyOrderShort m = *(ModifyOrderShort *)message;
-            m_dataExporter.set_time_offset(m.TimeOffset);
-            m_dataExporter.set_packet_infos(pktSeqNum, msgSeqNum);
-
-            m_obm.modify_order(m.OrderId, m.Price, m.Quantity);
-            break;
+            m_dataExporter.stop_export_stage();
         }
-
-        case 0x29: // DeleteOrder
+        catch (...)
         {
-            /*
-            From the CFE PITCH Spec:
-
-            "The Delete Order message is sent whenever a booked order is cancelled or
-            leaves the order book. The Order Id refers to the Order Id of the original
-            Add Order message. An order that is deleted from the book may return to the
-            book later under certain circumstances. Therefore, a Delete Order message
-            does not indicate that a given Order Id will not be sent again on a
-            subsequent Add Order message."
+            // The book stage error is the one reported
+        }
+        throw;
+    }
+    m_bookNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
 
-            Additional notes:
+    decoder.join();
+    m_dataExporter.stop_export_stage();
+    if (decodeError)
+        std::rethrow_exception(decodeError);
+}
 
-            Note the second part of the above comment from PITCH spec - deleted order
-            may return to the book under certain conditions.  This means that the same
-            Order ID may be used *again* following the delete.  So, while Ordder IDs are
-            unique among outstanding orders, they are not globally unique.
+template<typename Policy>
+void CBOEPcapParser::sharded(std::size_t shardCount)
+{
+    auto& config = Config::getInstance();
 
-            DeleteOrder is the second-most common message after AddOrder, with about 670
-            thousand DeleteOrder messages in the reference file.
-            */
+    m_shards.clear();
+    for (std::size_t i = 0; i < shardCount; ++i)
+    {
+        m_shards.push_back(std::make_unique<BookShard>(config.ringSize()));
+        m_shards.back()->store.reserve(config.orderCapacity() / shardCount + 1);
+    }
+    if (config.bbo())
+    {
+        m_dataExporter.start_export_stage(config.ringSize(), shardCount);
+        for (std::size_t i = 0; i < shardCount; ++i)
+            m_shards[i]->exporter.forward_to(&m_dataExporter.export_stream(i));
+    }
+    else
+    {
+        for (auto& shard : m_shards)
+            shard->exporter.forward_to(nullptr);
+    }
 
-            DeleteOrder m = *(DeleteOrder*)message;
-            m_dataExporter.set_time_offset(m.TimeOffset);
-            m_dataExporter.set_packet_infos(pktSeqNum, msgSeqNum);
+    // A shard sleeps on its ring while it has no event. With --bbo it tells the export stage which events it
+    // applied, and the decoder which ones it handed out, so that the merge knows how far each stream is complete.
+    auto book_stage = [&](std::size_t i)
+    {
+        BookShard& shard = *m_shards[i];
+        DataExporter::BBOStream* stream = config.bbo() ? &m_dataExporter.export_stream(i) : nullptr;
+        try
+        {
+            EventClock clock{};
+            PipelineEvent decoded{};
+            while (true)
+            {
+                if (!shard.events.try_pop(decoded))
+                {
+                    // Out of events, so complete up to the decoder: the merge may be waiting for that
+                    if (stream)
+                        stream->exportBell->ring();
+                    if (!shard.events.pop(decoded))
+                        break;
+                }
 
-            m_obm.cancel_order(m.OrderId);
-            break;
+                auto start = std::chrono::steady_clock::now();
+                uint64_t msgSeqNum = uint64_t{decoded.event.pktSeqNum} + decoded.event.msgIndex;
+                apply_event<Policy>(decoded.event, clock, decoded.definition.get(), shard.obm, shard.exporter);
+                shard.busyNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+                ++shard.eventCount;
+                if (stream)
+                    stream->apply(msgSeqNum);
+            }
         }
-        default:
+        catch (...)
         {
-            // Handle unknown message types
-            throw std::invalid_argument("Error: unrecognized message type " + std::to_string(msg_type));
+            shard.error = std::current_exception();
+            shard.events.cancel();
         }
-    }
-}
-
-void CBOEPcapParser::process_packet(const u_char *packet) noexcept
-{
-    /*
-    All PCAP data has the following header lengths:
-    Ethernet: 14 bytes
-    IP      : 20 bytes
-    UDP     : 8 bytes
+        // The records of a shard that failed stop here, the others are still merged
+        if (stream)
+            stream->ring.close();
+    };
+    for (std::size_t i = 0; i < shardCount; ++i)
+        m_shards[i]->thread = std::thread(book_stage, i);
+
+    // Decode stage, on this thread. Add orders go to the shard of their book (book % shardCount) and the router
+    // remembers it for the later messages of the order. The messages every book depends on (clock, transactions,
+    // definitions: each shard defines every book so that book indices agree) go to all shards.
+    auto start = std::chrono::steady_clock::now();
+    std::exception_ptr decodeError;
+    try
+    {
+        OrderRouter router;
+        router.reserve(config.orderCapacity());
+        EventClock clock{};
+        uint64_t message = 0;
+        bool running = true; // Until a shard stops taking events
+        bool inTransaction = false;
+        L3Event lastOrder{}; // Last order event and its TimeOffset: the stamp of a transaction the capture leaves open
+        uint32_t lastOrderOffset = 0;
+
+        auto shard_of_book = [&](Order::BookIndex book)
+        {
+            return book == L3Event::NoBook ? uint8_t{0} : static_cast<uint8_t>(book % shardCount);
+        };
+        auto deal = [&](std::size_t i, PipelineEvent&& decoded)
+        {
+            // An order the books never had (NoShard) fails on shard 0 as it would on a single book stage
+            i = i == OrderRouter::NoShard ? 0 : i;
+            if (config.bbo())
+                m_dataExporter.export_stream(i).hand(message);
+            running = running && m_shards[i]->events.push(std::move(decoded));
+        };
+
+        auto emit = [&](L3Event event, uint64_t pktSeqNum, uint64_t msgSeqNum, uint32_t timeOffset,
+                        const u_char* definition, std::size_t size)
+        {
+            // Every event of the previous messages has been handed out: the shards that applied theirs are
+            // complete up to there. Moved message by message, a shard never waits on a whole packet.
+            if (msgSeqNum != message)
+            {
+                m_dataExporter.set_decoded_through(msgSeqNum - 1);
+                message = msgSeqNum;
+            }
 
-    PITCH payload starts at byte 43.
-    */
-    int offset = 42;
+            PipelineEvent decoded = stage_event(event, clock, pktSeqNum, msgSeqNum, timeOffset, definition, size);
+            const L3Event& e = decoded.event;
+            auto quantity = static_cast<Order::Quantity>(e.quantity);
+            if (e.type >= L3EventType::Add && e.type <= L3EventType::Execute)
+            {
+                lastOrder = e;
+                lastOrderOffset = timeOffset;
+            }
+            else if (e.type == L3EventType::TransactionBegin || e.type == L3EventType::TransactionEnd)
+                inTransaction = e.type == L3EventType::TransactionBegin;
+            switch (e.type)
+            {
+                case L3EventType::Add:
+                {
+                    uint8_t shard = shard_of_book(e.book);
+                    router.add(e.orderId, shard, quantity);
+                    deal(shard, std::move(decoded));
+                    break;
+                }
+                case L3EventType::Delete:
+                    deal(router.erase(e.orderId), std::move(decoded));
+                    break;
+                case L3EventType::Modify:
+                    deal(router.modify(e.orderId, quantity), std::move(decoded));
+                    break;
+                case L3EventType::Reduce:
+                    deal(router.reduce(e.orderId, quantity), std::move(decoded));
+                    break;
+                case L3EventType::Execute:
+                    deal(router.execute(e.orderId, quantity), std::move(decoded));
+                    break;
+                case L3EventType::Status:
+                    deal(shard_of_book(e.book), std::move(decoded));
+                    break;
+                case L3EventType::Trade:
+                    break; // Off book
+                case L3EventType::Date:
+                    // The day's exporter gets no events but names the file after the date
+                    m_dataExporter.set_date(static_cast<std::time_t>(e.orderId));
+                    [[fallthrough]];
+                case L3EventType::Time:
+                case L3EventType::Instrument:
+                case L3EventType::TransactionBegin:
+                case L3EventType::TransactionEnd:
+                    for (std::size_t i = 0; i < shardCount; ++i)
+                    {
+                        PipelineEvent copy{e, nullptr};
+                        if (decoded.definition)
+                        {
+                            copy.definition = std::make_unique_for_overwrite<u_char[]>(size);
+                            std::memcpy(copy.definition.get(), decoded.definition.get(), size);
+                        }
+                        deal(i, std::move(copy));
+                    }
+                    break;
+            }
+        };
+        EventDecoder decoder{emit};
+        MessageDispatcher dispatcher{decoder};
 
-    SequencedUnitHeader suHeader = *(SequencedUnitHeader *)(packet + offset);
+        for_each_packet([&](const u_char* packet)
+        {
+            if (running)
+                dispatcher.packet(packet);
+        });
 
-    // Skip PITCH packets for Unit other than 1, unsequenced PITCH packets, and
-    // those with zero messages (heartbeats)
-    //(Time sequences will be reset to 1 each day when feed startup)
-    if (suHeader.HdrUnit != 1 || suHeader.HdrSequence == 0 || suHeader.HdrCount == 0)
+        // The transaction left open ends on every shard as OrderBookManager::finish() ends it on a single book
+        // stage: stamped with the last order message, every shard flushing its books after its last event
+        if (running && inTransaction)
+        {
+            L3Event end = lastOrder;
+            end.type = L3EventType::TransactionEnd;
+            uint64_t msgSeqNum = uint64_t{end.pktSeqNum} + end.msgIndex;
+            clock.stamp(end, end.pktSeqNum, msgSeqNum, lastOrderOffset); // From the Time the clock is at
+            if (config.bbo())
+                m_dataExporter.hold_from(msgSeqNum);
+            for (std::size_t i = 0; i < shardCount; ++i)
+                deal(i, PipelineEvent{end, nullptr});
+        }
+        report_skipped(dispatcher.skipped());
+    }
+    catch (...)
     {
-        return;
+        decodeError = std::current_exception();
+    }
+    for (auto& shard : m_shards)
+        shard->events.close();
+    m_decodeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+    for (auto& shard : m_shards)
+        shard->thread.join();
+    std::exception_ptr exportError;
+    try
+    {
+        m_dataExporter.stop_export_stage();
+    }
+    catch (...)
+    {
+        exportError = std::current_exception();
     }
 
-    uint64_t pktSeqNum = suHeader.HdrSequence;
-	uint64_t msgSeqNum = suHeader.HdrSequence;
-
-    // First message in packet
-    offset += sizeof(SequencedUnitHeader);
-    MessageHeader msgHeader = *(MessageHeader *)(packet + offset);
-    process_message(pktSeqNum, msgSeqNum, packet + offset + 2, msgHeader.MsgType);
-
-    // All remaining messages in packet
-    for (int j = 0; j < suHeader.HdrCount - 1; j++)
+    if (decodeError)
+        std::rethrow_exception(decodeError);
+    for (auto& shard : m_shards)
     {
-        ++msgSeqNum;
-        offset += msgHeader.MsgLen;
-        msgHeader = *(MessageHeader *)(packet + offset);
-        process_message(pktSeqNum, msgSeqNum, packet + offset + 2, msgHeader.MsgType);
+        if (shard->error)
+            std::rethrow_exception(shard->error);
     }
+    if (exportError)
+        std::rethrow_exception(exportError);
+}
+
+void CBOEPcapParser::show_orderbook()
+{
+    const auto& args = Config::getInstance().orderbook();
+    std::string time = args[1] + " " + args[2];
+
+    m_dataExporter.orderbook_printer(args[0], time);
 }
 
 void CBOEPcapParser::start()
@@ -672,68 +1276,220 @@ void CBOEPcapParser::start()
         sw.Start();
     }
 
-    char errbuf[PCAP_ERRBUF_SIZE];  // Buffer to store error messages
-    pcap_t* pcap;                   // PCAP handle
-    struct pcap_pkthdr header; // Header for packet metadata
-    const u_char* packet;      // Pointer to the packet data
-
-    // Attempt to open the provided PCAP file in offline mode
-    pcap = pcap_open_offline(m_pcapFilename.c_str(), errbuf);
-    if (pcap == nullptr) 
+    // With --eventLog a day whose log matches the capture is replayed from it, otherwise the log is written as the
+    // capture is parsed
+    std::optional<EventLogReader> log;
+    if (config.eventLog())
     {
-        throw std::runtime_error("Error: Unable to open the file " + m_pcapFilename);
+        EventLogSource source = EventLogSource::of(m_pcapFilename, m_range);
+        std::string logFilename = EventLogSource::log_filename(m_pcapFilename, m_range);
+        if (std::filesystem::exists(logFilename))
+        {
+            try
+            {
+                log.emplace(logFilename);
+            }
+            catch (const std::runtime_error&)
+            {
+                // Incomplete or from another version: rebuilt below
+            }
+            if (log && !log->built_from(source))
+                log.reset();
+        }
+
+        if (!log)
+        {
+            try
+            {
+                m_eventLog.open(logFilename, source);
+            }
+            catch (const std::ios_base::failure& e)
+            {
+                // The log is only a cache: a read-only capture directory must not prevent parsing
+                std::cerr << "Warning: " << e.what() << '\n';
+            }
+        }
     }
-    std::size_t counter = 0;
 
-    // Process each packet in the PCAP file
-    while ((packet = pcap_next(pcap, &header)) != nullptr) 
+    // --showOB looks at all the books at once: it stays on a single book stage
+    bool useShards = !log && config.shards() > 1 && !config.showOB();
+
+    // Allocate the order pool and index up front so the hot path never rehashes (shards size their own)
+    if (!useShards)
+        m_orderstore.reserve(config.orderCapacity());
+
+    with_book_policy([&]<typename Policy>()
     {
-        ++counter;
-        process_packet(packet);
+        if (log)
+            replay<Policy>(*log);
+        else if (useShards)
+            sharded<Policy>(config.shards());
+        else if (config.pipeline() || config.shards() > 1)
+            pipeline<Policy>();
+        else
+            parse<Policy>();
+    }, config.bbo(), !config.noChecks(), config.bbo() && config.conflate());
+    m_dataExporter.finish();
 
-        if (config.showOB())
+    if (m_eventLog.is_open())
+    {
+        try
         {
-            auto args = config.orderbook();
-            std::string time = args[1] + " " + args[2];
-
-            m_dataExporter.orderbook_printer(args[0], time);
+            m_eventLog.close();
+        }
+        catch (const std::ios_base::failure& e)
+        {
+            std::cerr << "Warning: " << e.what() << '\n';
         }
     }
-    
-    // Close the PCAP file
-    pcap_close(pcap);
 
     sw.Stop();
     if (config.time())
+    {
         sw.display_time();
+
+        if (log)
+            std::cout << std::format("Day {} replayed {} events from its event log\n", m_id, m_replayedEvents);
+        else if (config.eventLog())
+            std::cout << std::format("Day {} wrote {} events to its event log\n", m_id, m_eventLog.size());
+
+        // Busy time of a stage is its lifetime less its waits: the stage left with little waiting bounds the day
+        if (m_eventRing)
+        {
+            std::cout << std::format("Day {} pipeline decode stage: {:.3f} ms, {:.3f} ms blocked on a full ring of {} events\n", m_id,
+                                     m_decodeNs / 1e6, m_eventRing->producer_wait_ms(), m_eventRing->capacity());
+            std::cout << std::format("Day {} pipeline book stage: {:.3f} ms, {:.3f} ms waiting for events", m_id,
+                                     m_bookNs / 1e6, m_eventRing->consumer_wait_ms());
+            if (m_dataExporter.export_streams())
+            {
+                const auto& ring = m_dataExporter.export_stream(0).ring;
+                std::cout << std::format(", {:.3f} ms blocked on a full ring of {} BBO records\n", ring.producer_wait_ms(), ring.capacity());
+            }
+            else
+            {
+                std::cout << '\n';
+            }
+        }
+        // A shard is idle for the time it is not applying events: waiting on the decoder or on the export stage
+        for (std::size_t i = 0; i < m_shards.size(); ++i)
+        {
+            const BookShard& shard = *m_shards[i];
+            std::cout << std::format("Day {} shard {}: {} events ({} order messages) applied in {:.3f} ms\n", m_id, i,
+                                     shard.eventCount, shard.obm.order_messages(), shard.busyNs / 1e6);
+        }
+        if (!m_shards.empty())
+        {
+            std::cout << std::format("Day {} shard decode stage: {:.3f} ms\n", m_id, m_decodeNs / 1e6);
+        }
+        if (m_dataExporter.export_streams())
+        {
+            std::cout << std::format("Day {} pipeline export stage: {:.3f} ms, {:.3f} ms waiting for records\n", m_id,
+                                     m_dataExporter.export_stage_ms(), m_dataExporter.export_wait_ms());
+        }
+
+        // Lookups in the order id index, ideally one per order message. With --shards each shard has its own store.
+        uint64_t messages = m_obm.order_messages();
+        uint64_t probes = m_orderstore.probes();
+        std::size_t peak = m_orderstore.capacity();
+        for (const auto& shard : m_shards)
+        {
+            messages += shard->obm.order_messages();
+            probes += shard->store.probes();
+            peak += shard->store.capacity();
+        }
+        std::cout << std::format("Day {} order id probes: {} for {} order messages ({:.2f} per message)\n", m_id,
+                                 probes, messages, messages ? double(probes) / messages : 0.0);
+        std::cout << std::format("Day {} order layout: {} hot bytes ({} per cache line), {} cold bytes, peak {} live orders\n", m_id,
+                                 sizeof(Order), 64 / sizeof(Order), sizeof(OrderStore::ColdOrder), peak);
+        if (uint64_t records = m_dataExporter.bbo_records())
+        {
+            std::cout << std::format("Day {} BBO records: {} formatted in {:.3f} ms ({:.1f} ns per record)\n", m_id, records,
+                                     m_dataExporter.bbo_format_ms(), m_dataExporter.bbo_format_ms() * 1e6 / records);
+        }
+    }
 }
 
 void CBOEPcapParser::messages_summary()
 {
     auto& config = Config::getInstance();
 
-    char errbuf[PCAP_ERRBUF_SIZE];  // Buffer to store error messages
-    pcap_t* pcap;                   // PCAP handle
-    struct pcap_pkthdr header; // Header for packet metadata
-    const u_char* packet;      // Pointer to the packet data
+    auto run = [&](auto&... sinks)
+    {
+        MessageDispatcher dispatcher{sinks...};
 
-    // Attempt to open the provided PCAP file in offline mode
-    pcap = pcap_open_offline(m_pcapFilename.c_str(), errbuf);
-    if (pcap == nullptr) 
+        // Process each packet in the PCAP file
+        for_each_packet([&](const u_char* packet)
+        {
+            dispatcher.packet(packet);
+        });
+        report_skipped(dispatcher.skipped());
+    };
+
+    GapChecker gaps{m_messageInfo};
+    MessageCounter counter{m_messageInfo};
+    if (config.gaps() && config.msgSummary())
+        run(gaps, counter);
+    else if (config.gaps())
+        run(gaps);
+    else if (config.msgSummary())
+        run(counter);
+
+    print_summary();
+}
+
+template<typename Policy>
+std::size_t CBOEPcapParser::fused_pass(std::size_t firstDay)
+{
+    auto& config = Config::getInstance();
+    DaySplitter<Policy> days{m_pcapFilename, firstDay};
+
+    auto run = [&](auto&... sinks)
     {
-        throw std::runtime_error("Error: Unable to open the file " + m_pcapFilename);
-    }
-    // Process each packet in the PCAP file
-    while ((packet = pcap_next(pcap, &header)) != nullptr) 
+        MessageDispatcher dispatcher{sinks..., days};
+
+        // Process each packet in the PCAP file
+        for_each_packet([&](const u_char* packet)
+        {
+            dispatcher.packet(packet);
+
+            if (config.showOB() && days.day())
+                days.day()->show_orderbook();
+        });
+        days.finish_day();
+        report_skipped(dispatcher.skipped());
+    };
+
+    GapChecker gaps{m_messageInfo};
+    MessageCounter counter{m_messageInfo};
+    if (config.gaps() && config.msgSummary())
+        run(gaps, counter);
+    else if (config.gaps())
+        run(gaps);
+    else if (config.msgSummary())
+        run(counter);
+    else
+        run();
+
+    return days.days();
+}
+
+std::size_t CBOEPcapParser::single_pass(std::size_t firstDay)
+{
+    auto& config = Config::getInstance();
+
+    std::size_t dayCount = 0;
+    with_book_policy([&]<typename Policy>()
     {
-        if (config.gaps())
-            gap_helper(packet);
-        if (config.msgSummary())
-            messages_summary_helper(packet);
-    }
-    // Close the PCAP file
-    pcap_close(pcap);
+        dayCount = fused_pass<Policy>(firstDay);
+    }, config.bbo(), !config.noChecks(), config.bbo() && config.conflate());
+
+    print_summary();
+    return dayCount;
+}
 
+void CBOEPcapParser::print_summary()
+{
+    auto& config = Config::getInstance();
 
     if (config.gaps())
     {
@@ -755,33 +1511,23 @@ void CBOEPcapParser::messages_summary()
     if (config.msgSummary())
     {
         std::cout << "Message Counts by Date and Type:" << std::endl;
-        for (const auto& dateEntry : m_messageInfo.dailyMessageCounts)
+        for (std::size_t day = 0; day < m_messageInfo.tradeDates.size(); ++day)
         {
-            if (dateEntry.first.empty())
+            uint32_t tradeDate = m_messageInfo.tradeDates[day];
+            if (tradeDate == 0)
                 continue;
 
-            std::string date = dateEntry.first;
-            date.insert(4, "-");
-            date.insert(7, "-");
-
-            std::cout << "Date: " << date << std::endl;
-            for (const auto& typeEntry : m_messageInfo.messageTypeInfo)
+            std::cout << std::format("Date: {:04}-{:02}-{:02}\n", tradeDate / 10000, tradeDate / 100 % 100, tradeDate % 100);
+            const MessageInfo::TypeCounts& counts = m_messageInfo.dailyMessageCounts[day];
+            for (const MessageDescriptor& descriptor : PitchMessageTable)
             {
-                auto it = dateEntry.second.find(typeEntry.first);
-                if (it != dateEntry.second.end())
-                {
-                    std::cout << std::format("  Type: {:<28} (0x{:02X}) - Count: {:>9}\n",
-                                            typeEntry.second,
-                                            static_cast<int>(typeEntry.first),
-                                            it->second);
-                }
-                else
-                {
-                    std::cout << std::format("  Type: {:<28} (0x{:02X}) - Count: {:>9}\n",
-                                            typeEntry.second,
-                                            static_cast<int>(typeEntry.first),
-                                            0);
-                }
+                if (descriptor.size == 0)
+                    continue; // Not a type of the feed
+
+                std::cout << std::format("  Type: {:<28} (0x{:02X}) - Count: {:>9}\n",
+                                        descriptor.name,
+                                        static_cast<int>(descriptor.type),
+                                        counts[descriptor.type]);
             }
         }
         std::cout << std::endl;
@@ -789,115 +1535,194 @@ void CBOEPcapParser::messages_summary()
     m_messageInfo = MessageInfo{}; // Reset the message counter
 }
 
-void CBOEPcapParser::gap_helper(const u_char *packet) noexcept
+void CBOEPcapParser::report_skipped(const std::array<uint64_t, 256>& skipped) const
 {
-    int offset = 42;
-    SequencedUnitHeader suHeader = *(SequencedUnitHeader *)(packet + offset);
-
-    if (suHeader.HdrUnit != 1 || suHeader.HdrSequence == 0 || suHeader.HdrCount == 0)
+    for (std::size_t type = 0; type < skipped.size(); ++type)
     {
-        return;
+        if (skipped[type] == 0)
+            continue;
+
+        const MessageDescriptor& descriptor = PitchMessageTable[type];
+        std::cerr << std::format("Warning: {} skipped {} {} message(s) of type 0x{:02X}\n", m_pcapFilename, skipped[type],
+                                 descriptor.size ? "truncated" : "unknown", type);
     }
+}
+
+// ------------------ PCAP Slicer ------------------
+
+PcapSlicer::PcapSlicer(const std::string& filename) 
+    : m_pcapFilename(filename), m_dayCount{0}
+{}
+
+std::string PcapSlicer::slice_pcap(const std::string& begin_time, const std::string& end_time, const std::string& output_filename,
+                                   SliceRange::Clock clock)
+{
+    // Regex to check that the begin_time and end_time have good format
+    const std::regex time_pattern(R"(^(\d{4})-(\d{2})-(\d{2})T(\d{2}):(\d{2}):(\d{2})$)");
+    std::smatch begin_match, end_match;
 
-    // Gap detection
-    if (m_messageInfo.gNextExpectedPacketSeqNum)
+    if (!std::regex_match(begin_time, begin_match, time_pattern) || !std::regex_match(end_time, end_match, time_pattern)) 
     {
-        if (suHeader.HdrSequence != m_messageInfo.gNextExpectedPacketSeqNum && suHeader.HdrSequence != 1)
-        {
-            unsigned int hdrSeq = suHeader.HdrSequence;
-            m_messageInfo.packet_gaps.push_back({m_messageInfo.gNextExpectedPacketSeqNum, hdrSeq});
-        }
+        throw std::invalid_argument("Invalid format for the start or end time: Expected format (ISO 8601) is 'YYYY-MM-DDTHH:MM:SS'");
     }
-    m_messageInfo.gNextExpectedPacketSeqNum = suHeader.HdrSequence + suHeader.HdrCount;
+
+    auto to_nanoseconds = [clock](const std::smatch& match) -> uint64_t
+    {
+        std::tm tm{};
+        tm.tm_year = std::stoi(match[1]) - 1900;
+        tm.tm_mon = std::stoi(match[2]) - 1;
+        tm.tm_mday = std::stoi(match[3]);
+        tm.tm_hour = std::stoi(match[4]);
+        tm.tm_min = std::stoi(match[5]);
+        tm.tm_sec = std::stoi(match[6]);
+        tm.tm_isdst = -1;
+
+        // Exchange times follow the DataExporter convention (UTC date of the midnight reference),
+        // capture times are local like editcap's -A/-B
+        std::time_t seconds = clock == SliceRange::Clock::Exchange ? timegm(&tm) : std::mktime(&tm);
+        return static_cast<uint64_t>(seconds) * 1'000'000'000;
+    };
+
+    std::cout << "\nSlicing pcap file " << m_pcapFilename << " from " << begin_time << " to " << end_time << std::endl;
+
+    auto outputs = slice_pcap({{to_nanoseconds(begin_match), to_nanoseconds(end_match), clock, output_filename}});
+
+    std::cout << "Slicing executed successfully. File was placed at: " << outputs.front() << "\n\n";
+    return outputs.front();
 }
 
-void CBOEPcapParser::messages_summary_helper(const u_char *packet) noexcept
+std::vector<std::string> PcapSlicer::slice_pcap(const std::vector<SliceRange>& ranges)
 {
-    int offset = 42;
-    SequencedUnitHeader suHeader = *(SequencedUnitHeader *)(packet + offset);
+    if (ranges.empty())
+        return {};
+
+    MmapPcapReader reader(m_pcapFilename);
+    PcapRecord record;
 
-    if (suHeader.HdrUnit != 1 || suHeader.HdrSequence == 0 || suHeader.HdrCount == 0)
+    // One buffered writer per range, each starting with a copy of the input file header
+    using File = std::unique_ptr<FILE, decltype(&std::fclose)>;
+    std::vector<File> outputs;
+    std::vector<std::string> paths;
+    outputs.reserve(ranges.size());
+
+    // A short write (full disk, quota) must not leave a silently truncated slice behind
+    auto write = [&ranges, &outputs](std::size_t i, const void* data, std::size_t size)
     {
-        return;
-    }
+        if (std::fwrite(data, 1, size, outputs[i].get()) != size)
+            throw std::ios_base::failure(std::format("Failed to write {}: {}", ranges[i].output_filename, std::strerror(errno)));
+    };
 
-    // First message in packet
-    offset += sizeof(SequencedUnitHeader);
-    MessageHeader msgHeader = *(MessageHeader *)(packet + offset);
-    m_messageInfo.totalMessages++;
-    m_messageInfo.messageCounts[msgHeader.MsgType]++;
-    
-    // Ensure the date entry exists in the map
-    if (!m_messageInfo.dailyMessageCounts.contains(m_messageInfo.currentTradeDate)) 
+    for (const auto& range : ranges)
     {
-        m_messageInfo.dailyMessageCounts[m_messageInfo.currentTradeDate] = std::unordered_map<uint8_t, int>();
+        if (range.begin > range.end)
+            throw std::invalid_argument("Invalid slice range: begin is after end for " + range.output_filename);
+
+        File file{std::fopen(range.output_filename.c_str(), "wb"), &std::fclose};
+        if (file == nullptr)
+            throw std::runtime_error("Error opening output file: " + range.output_filename);
+
+        std::setvbuf(file.get(), nullptr, _IOFBF, 4 * 1024 * 1024); // 4 MB buffer
+        outputs.push_back(std::move(file));
+        write(outputs.size() - 1, reader.file_header(), MmapPcapReader::FileHeaderSize);
+        paths.push_back(std::filesystem::absolute(range.output_filename).string());
     }
-    m_messageInfo.dailyMessageCounts[m_messageInfo.currentTradeDate][msgHeader.MsgType]++;
-    if (msgHeader.MsgType == 0xB1) // TimeReference
+
+    const bool needExchange = std::ranges::any_of(ranges, [](const auto& r) { return r.clock == SliceRange::Clock::Exchange; });
+    uint64_t firstBegin[2] = {UINT64_MAX, UINT64_MAX};  // Indexed by clock
+    uint64_t lastEnd[2] = {0, 0};
+    for (const auto& range : ranges)
     {
-        TimeReference m = *(TimeReference*)(packet + offset + 2);
-        m_messageInfo.currentTradeDate = std::to_string(m.TradeDate);
+        auto c = static_cast<std::size_t>(range.clock);
+        firstBegin[c] = std::min(firstBegin[c], range.begin);
+        lastEnd[c] = std::max(lastEnd[c], range.end);
     }
 
-    // All remaining messages in packet
-    for (int j = 0; j < suHeader.HdrCount - 1; j++)
-    {
-        offset += msgHeader.MsgLen;
-        msgHeader = *(MessageHeader *)(packet + offset);
-        m_messageInfo.totalMessages++;
-        m_messageInfo.messageCounts[msgHeader.MsgType]++;
-        
-        // Ensure the date entry exists in the map
-        if (!m_messageInfo.dailyMessageCounts.contains(m_messageInfo.currentTradeDate)) 
-        {
-            m_messageInfo.dailyMessageCounts[m_messageInfo.currentTradeDate] = std::unordered_map<uint8_t, int>();
-        }
-        m_messageInfo.dailyMessageCounts[m_messageInfo.currentTradeDate][msgHeader.MsgType]++;
+    // Exchange clock state, carried across packets
+    uint64_t midnight = 0;  // UTC midnight of the trade date, in seconds
+    uint64_t seconds = 0;   // Seconds since midnight from the last Time message
+    uint64_t exchangeTime = 0;
 
-        if (msgHeader.MsgType == 0xB1) // TimeReference
+    // With an up to date sidecar index, skip straight to the last indexed packet before the earliest range
+    if (auto index = PacketIndex::load(m_pcapFilename))
+    {
+        const PacketIndex::Entry* pcapEntry = index->seek_pcap_time(firstBegin[0]);
+        const PacketIndex::Entry* exchangeEntry = index->seek_exchange_time(firstBegin[1] / 1'000'000'000);
+        const PacketIndex::Entry* entry = !needExchange ? pcapEntry
+                                        : firstBegin[0] == UINT64_MAX ? exchangeEntry
+                                        : (pcapEntry && exchangeEntry) ? std::min(pcapEntry, exchangeEntry) : nullptr;
+        if (entry != nullptr)
         {
-            TimeReference m = *(TimeReference*)(packet + offset + 2);
-            m_messageInfo.currentTradeDate = std::to_string(m.TradeDate);
+            reader.set_range(entry->offset, reader.file_size());
+            midnight = uint64_t{entry->midnightReference} / 86400 * 86400;
+            seconds = entry->time;
         }
     }
-}
-
-// ------------------ PCAP Slicer ------------------
 
-PcapSlicer::PcapSlicer(const std::string& filename) 
-    : m_pcapFilename(filename)
-{}
+    constexpr std::size_t headerOffset = 42;
+    while (reader.next(record))
+    {
+        if (needExchange && record.caplen >= headerOffset + sizeof(SequencedUnitHeader))
+        {
+            SequencedUnitHeader suHeader;
+            std::memcpy(&suHeader, record.data + headerOffset, sizeof(SequencedUnitHeader));
 
-std::string PcapSlicer::slice_pcap(const std::string& begin_time, const std::string& end_time, const std::string& output_filename)
-{
-    // Display the full filepath of the output 
-    std::filesystem::path p = std::filesystem::absolute(output_filename);
+            if (suHeader.HdrUnit == 1 && suHeader.HdrSequence != 0)
+            {
+                // Packet time: clock of the first timestamped message (Time messages only move the seconds)
+                std::optional<uint32_t> timeOffset;
+                std::size_t offset = headerOffset + sizeof(SequencedUnitHeader);
+                for (int j = 0; j < suHeader.HdrCount && offset + sizeof(MessageHeader) <= record.caplen; ++j)
+                {
+                    MessageHeader msgHeader;
+                    std::memcpy(&msgHeader, record.data + offset, sizeof(MessageHeader));
+                    if (msgHeader.MsgLen < sizeof(MessageHeader) + 4 || offset + msgHeader.MsgLen > record.caplen)
+                        break;
+
+                    const u_char* message = record.data + offset + sizeof(MessageHeader);
+                    if (msgHeader.MsgType == 0x20 && msgHeader.MsgLen >= sizeof(MessageHeader) + sizeof(Time))
+                    {
+                        seconds = reinterpret_cast<const Time*>(message)->Time;
+                    }
+                    else if (msgHeader.MsgType == 0xB1 && msgHeader.MsgLen >= sizeof(MessageHeader) + sizeof(TimeReference))
+                    {
+                        const auto* m = reinterpret_cast<const TimeReference*>(message);
+                        midnight = uint64_t{m->MidnightReference} / 86400 * 86400;
+                        seconds = m->Time;
+                    }
+                    else if (!timeOffset)
+                    {
+                        uint32_t value;
+                        std::memcpy(&value, message, sizeof(value)); // TimeOffset is the first field of every other message
+                        timeOffset = value;
+                    }
+                    offset += msgHeader.MsgLen;
+                }
+                exchangeTime = (midnight + seconds) * 1'000'000'000 + timeOffset.value_or(0);
+            }
+        }
 
-    // Regex to check that the begin_time and end_time have good format
-    const std::regex time_pattern(R"(^\d{4}-\d{2}-\d{2}T\d{2}:\d{2}:\d{2}$)");
+        // Captures are chronological: nothing more to write once every clock is past its last range
+        if (record.timestamp >= lastEnd[0] && (!needExchange || exchangeTime >= lastEnd[1]))
+            break;
 
-    if (!std::regex_match(begin_time, time_pattern) || !std::regex_match(end_time, time_pattern)) 
-    {
-        throw std::invalid_argument("Invalid format for the start or end time: Expected format (ISO 8601) is 'YYYY-MM-DDTHH:MM:SS'");
+        for (std::size_t i = 0; i < ranges.size(); ++i)
+        {
+            uint64_t t = ranges[i].clock == SliceRange::Clock::Pcap ? record.timestamp : exchangeTime;
+            if (t >= ranges[i].begin && t < ranges[i].end)
+                write(i, record.data - MmapPcapReader::RecordHeaderSize, MmapPcapReader::RecordHeaderSize + record.caplen);
+        }
     }
 
-    std::stringstream command;
-    command << "editcap -A " << begin_time << " -B " << end_time << " " << m_pcapFilename << " " << output_filename;
-    
-    std::cout << "\nSlicing pcap file. Executing command: " << command.str() << std::endl;
-    
-    int result = std::system(command.str().c_str());
-    
-    if (result == 0)
+    for (std::size_t i = 0; i < outputs.size(); ++i)
     {
-        std::cout << "Slicing executed successfully. File was placed at: " << p << "\n\n";
-        return p;
+        if (std::fclose(outputs[i].release()) != 0)
+            throw std::ios_base::failure(std::format("Failed to write {}: {}", ranges[i].output_filename, std::strerror(errno)));
     }
-    else
-        throw std::invalid_argument("Failed to execute editcap command");   
+
+    return paths;
 }
 
-void PcapSlicer::daily_slice()
+std::size_t PcapSlicer::daily_slice(std::size_t firstDay)
 {
     // Open the input PCAP file
     char errbuf[PCAP_ERRBUF_SIZE];
@@ -911,7 +1736,7 @@ void PcapSlicer::daily_slice()
     struct pcap_pkthdr* header;
 
     // Prepare for slicing
-    std::size_t dayCount = 1;
+    std::size_t dayCount = firstDay;
     pcap_t* pcap_out = nullptr;
     pcap_dumper_t* pcap_dumper = nullptr;
 
@@ -991,5 +1816,51 @@ void PcapSlicer::daily_slice()
         pcap_close(pcap_out);
     }
     pcap_close(pcap);
+
+    m_dayCount = dayCount - firstDay;
+    return m_dayCount;
 }
 
+std::vector<DayRange> PcapSlicer::daily_scan()
+{
+    MmapPcapReader reader(m_pcapFilename);
+    PcapRecord record;
+    std::vector<DayRange> days;
+
+    std::size_t dayBegin = MmapPcapReader::FileHeaderSize;
+    constexpr int offset = 42;
+
+    while (reader.next(record))
+    {
+        if (record.caplen < offset + sizeof(SequencedUnitHeader)) 
+        {
+            continue; // Not enough data
+        }
+
+        SequencedUnitHeader suHeader;
+        std::memcpy(&suHeader, record.data + offset, sizeof(SequencedUnitHeader));
+
+        if (suHeader.HdrUnit != 1 || suHeader.HdrSequence == 0 || suHeader.HdrCount == 0)
+        {
+            continue;
+        }
+
+        // Sequence numbers are reset to 1 at every feed startup: a sequence going backwards starts a new day.
+        // Gaps inside a day do not split it, the day worker keeps its book state across them.
+        if (suHeader.HdrSequence < m_gNextExpectedPacketSeqNum)
+        {
+            days.push_back({dayBegin, record.offset});
+            dayBegin = record.offset;
+        }
+
+        m_gNextExpectedPacketSeqNum = suHeader.HdrSequence + suHeader.HdrCount;
+    }
+
+    if (reader.offset() > dayBegin)
+    {
+        days.push_back({dayBegin, reader.offset()});
+    }
+
+    m_dayCount = days.size();
+    return days;
+}
\ No newline at end of file
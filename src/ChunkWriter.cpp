@@ -0,0 +1,144 @@
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <ios>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "ChunkWriter.hpp"
+
+ChunkWriter::ChunkWriter(std::size_t chunkSize)
+    : m_chunkSize{chunkSize}, m_buffers{}, m_active{0}, m_fd{-1}, m_filename{}, m_thread{}, m_mutex{}, m_cv{},
+      m_inFlight{nullptr}, m_inFlightSize{0}, m_closing{false}, m_error{0}
+{
+}
+
+ChunkWriter::~ChunkWriter() noexcept
+{
+    try
+    {
+        close();
+    }
+    catch (...)
+    {
+    }
+}
+
+void ChunkWriter::open(const std::string& filename)
+{
+    if (is_open())
+        close();
+
+    m_fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (m_fd < 0)
+        throw std::ios_base::failure("Failed to open file: " + filename);
+
+    if (!m_buffers[0])
+    {
+        m_buffers[0] = std::make_unique<char[]>(m_chunkSize);
+        m_buffers[1] = std::make_unique<char[]>(m_chunkSize);
+    }
+    m_filename = filename;
+    m_active = 0;
+    m_closing = false;
+    m_error = 0;
+    setp(m_buffers[0].get(), m_buffers[0].get() + m_chunkSize);
+    m_thread = std::thread(&ChunkWriter::run, this);
+}
+
+bool ChunkWriter::is_open() const noexcept
+{
+    return m_fd >= 0;
+}
+
+void ChunkWriter::close()
+{
+    if (!is_open())
+        return;
+
+    submit();
+    {
+        std::lock_guard lock(m_mutex);
+        m_closing = true;
+    }
+    m_cv.notify_all();
+    m_thread.join();
+
+    ::close(m_fd);
+    m_fd = -1;
+    setp(nullptr, nullptr);
+
+    if (m_error != 0)
+        throw std::ios_base::failure(std::format("Failed to write {}: {}", m_filename, std::strerror(m_error)));
+}
+
+ChunkWriter::int_type ChunkWriter::overflow(int_type ch)
+{
+    if (!is_open() || !submit())
+        return traits_type::eof();
+
+    if (!traits_type::eq_int_type(ch, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+bool ChunkWriter::submit()
+{
+    std::size_t size = static_cast<std::size_t>(pptr() - pbase());
+    if (size == 0)
+        return true;
+
+    {
+        std::unique_lock lock(m_mutex);
+        m_cv.wait(lock, [this] { return m_inFlight == nullptr; });
+        if (m_error != 0)
+            return false;
+
+        m_inFlight = pbase();
+        m_inFlightSize = size;
+    }
+    m_cv.notify_all();
+
+    m_active ^= 1;
+    setp(m_buffers[m_active].get(), m_buffers[m_active].get() + m_chunkSize);
+    return true;
+}
+
+void ChunkWriter::run()
+{
+    std::unique_lock lock(m_mutex);
+    for (;;)
+    {
+        m_cv.wait(lock, [this] { return m_inFlight != nullptr || m_closing; });
+        if (m_inFlight == nullptr)
+            return; // Closing and everything submitted is written
+
+        const char* data = m_inFlight;
+        std::size_t size = m_inFlightSize;
+        lock.unlock();
+
+        int error = 0;
+        while (size > 0)
+        {
+            ssize_t written = ::write(m_fd, data, size);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                error = errno;
+                break;
+            }
+            data += written;
+            size -= static_cast<std::size_t>(written);
+        }
+
+        lock.lock();
+        if (error != 0 && m_error == 0)
+            m_error = error;
+        m_inFlight = nullptr;
+        m_cv.notify_all();
+    }
+}
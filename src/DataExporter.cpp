@@ -1,4 +1,8 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
 #include <string>
+#include <cstdio>
 #include <cstring>
 #include <iostream>
 #include <iomanip>
@@ -6,40 +10,88 @@
 #include <fstream>
 #include <unordered_map>
 #include <stdexcept>
+#include <utility>
 
+#include "Config.hpp"
 #include "DataExporter.hpp"
 #include "OrderBookManager.hpp"
 #include "cfepitch.h"
 
-DataExporter::DataExporter(std::size_t id) noexcept
-    : m_bboBuffer{}, m_binaryOutfile{}, m_symbolToReadableMap{}, m_filename{"../bbo" + std::to_string(id) + ".bin"}, 
-    m_Time{}, m_date{}, m_timeRef{}, m_timeOffset{}, m_pktSqNum{}, m_msgSqNum{}
+DataExporter::DataExporter() noexcept
+    : m_bboWriter{}, m_bboFormat{Config::getInstance().bboFormat()}, m_symbolToReadableMap{}, m_bboSymbols{},
+    m_output{nullptr}, m_forwarding{false}, m_finished{false}, m_exportStreams{}, m_exportThread{}, m_exportError{}, m_exportNs{0}, m_exportWaitNs{0},
+    m_exportBell{}, m_decodedThrough{0}, m_heldFrom{UINT64_MAX},
+    m_bboFilename{}, m_exportSymbols{}, m_symbolMaps(1),
+    m_timePrefix{}, m_timePrefixSize{0}, m_prefixSecond{UINT64_MAX}, m_timed{Config::getInstance().time()}, m_bboRecords{0}, m_bboFormatNs{0},
+    m_Time{}, m_date{}, m_midnight{0}, m_utcOffset{0}, m_timeRef{}, m_timeOffset{}, m_pktSqNum{}, m_msgSqNum{}, m_flushOrder{0}
 {
-    //m_binaryOutfile.open(m_filename, std::ios::out | std::ios::binary);
+#ifdef MBO_WITH_PARQUET
+    if (m_bboFormat == BBOFormat::Parquet)
+        m_parquetWriter = std::make_unique<ParquetBBOWriter>();
+#endif
 }
 
 DataExporter::~DataExporter()
 {
-    flush_csv_buffer();
-    //flush_binary_buffer();
-
-    if (m_binaryOutfile.is_open()) 
+    if (m_exportThread.joinable())
+    {
+        for (auto& stream : m_exportStreams)
+            stream->ring.close();
+        m_exportThread.join();
+    }
+    // A day left unfinished by an error keeps what it wrote under its temporary name, no file is created or
+    // truncated for it
+    try
+    {
+        if (!m_forwarding && !m_finished && bbo_open())
+            flush_bbo();
+    }
+    catch (...)
     {
-        m_binaryOutfile.close();
-        std::string fn = "../bbo" + std::string(m_date) + ".bin";
-        //std::rename(m_filename.c_str(), fn.c_str());
     }
 }
 
+DataExporter::BBOStream::BBOStream(std::size_t ringSize, Doorbell* exportBell)
+    : ring{ringSize, exportBell}, handedThrough{0}, appliedThrough{0}, exportBell{exportBell}
+{
+}
+
+void DataExporter::BBOStream::hand(uint64_t msgSeqNum) noexcept
+{
+    handedThrough.store(msgSeqNum, std::memory_order_release);
+}
+
+void DataExporter::BBOStream::apply(uint64_t msgSeqNum) noexcept
+{
+    appliedThrough.store(msgSeqNum, std::memory_order_release);
+}
+
 void DataExporter::set_obm(OrderBookManager* obm)
 {
     m_obm = obm;
 }
 
+void DataExporter::finish()
+{
+    if (m_forwarding || m_finished)
+        return;
+
+    // Not retried: a file that failed stays as it is
+    m_finished = true;
+    flush_bbo();
+
+    // Named after the last date of the day, which is only known now
+    std::string filename = bbo_filename(m_date);
+    if (std::rename(m_bboFilename.c_str(), filename.c_str()) != 0)
+        throw std::ios_base::failure("Failed to rename " + m_bboFilename + " to " + filename);
+}
+
 void DataExporter::set_date(std::time_t date)
 {
     std::tm date_buffer = *std::gmtime(&date);
     std::snprintf(m_date, 12, "%04d-%02d-%02d", date_buffer.tm_year + 1900, date_buffer.tm_mon + 1, date_buffer.tm_mday);
+    m_midnight = static_cast<uint64_t>(date);
+    m_utcOffset = -static_cast<int32_t>(date % 86400);
 }
 
 void DataExporter::set_time_ref(uint32_t time) noexcept
@@ -47,15 +99,21 @@ void DataExporter::set_time_ref(uint32_t time) noexcept
     m_timeRef = time;
 }
 
-void DataExporter::set_time_offset(uint32_t timeOffset) noexcept
+void DataExporter::set_message_infos(uint32_t timeOffset, uint64_t pktSqNum, uint64_t msgSqNum) noexcept
 {
     m_timeOffset = timeOffset;
+    m_pktSqNum = pktSqNum;
+    m_msgSqNum = msgSqNum;
 }
 
-void DataExporter::set_packet_infos(uint64_t pktSqNum, uint64_t msgSqNum) noexcept
+uint64_t DataExporter::message_seq_num() const noexcept
 {
-    m_pktSqNum = pktSqNum;
-    m_msgSqNum = msgSqNum;
+    return m_msgSqNum;
+}
+
+void DataExporter::set_flush_order(uint64_t msgSqNum) noexcept
+{
+    m_flushOrder = msgSqNum;
 }
 
 std::string DataExporter::get_human_readable_symbol(const Symbol& symbol) const noexcept
@@ -63,57 +121,330 @@ std::string DataExporter::get_human_readable_symbol(const Symbol& symbol) const
     return m_symbolToReadableMap.left.at(symbol);
 }
 
-void DataExporter::store_BBO_records(char msgType, const Symbol& symbol, Order::Price bidPrice, uint32_t bidQuantity,
-                   Order::Price askPrice, uint32_t askQuantity, uint8_t tradingStatus) noexcept
+uint32_t DataExporter::bbo_symbol(const Symbol& symbol)
 {
-    time_stamp_tostring();
+    auto it = std::ranges::find(m_bboSymbols, symbol, &std::pair<Symbol, std::string>::first);
+    if (it == m_bboSymbols.end())
+        it = m_bboSymbols.insert(it, {symbol, get_human_readable_symbol(symbol)});
 
-    m_bboBuffer << m_Time << ','
-                << m_pktSqNum << ','
-                << m_msgSqNum << ','
-                << msgType << ','
-                << m_symbolToReadableMap.left.at(symbol) << ','
-                << bidPrice * 10e-3 << ','
-                << bidQuantity << ','
-                << askPrice * 10e-3 << ','
-                << askQuantity << ','
-                << tradingStatus << '\n';
+    return static_cast<uint32_t>(it - m_bboSymbols.begin());
 }
 
+namespace
+{
+    constexpr std::ptrdiff_t MaxDigits = 20; // Of any 64 bit integer
+}
 
-void DataExporter::write_BBO_to_binary(char msgType, const std::string& symbol, Order::Price bidPrice, uint32_t bidQuantity,
-                                       Order::Price askPrice, uint32_t askQuantity, uint8_t tradingStatus)
+void DataExporter::store_BBO_records(char msgType, uint32_t symbol, Order::Price bidPrice, uint32_t bidQuantity,
+                   Order::Price askPrice, uint32_t askQuantity, uint8_t tradingStatus)
 {
-    if (!m_binaryOutfile.is_open()) 
+    BBORecord record{};
+    record.timestamp = bbo_timestamp();
+    record.bidPrice = bidPrice;
+    record.askPrice = askPrice;
+    record.bidQuantity = bidQuantity;
+    record.askQuantity = askQuantity;
+    record.pktSeqNum = m_pktSqNum;
+    record.msgSeqNum = m_msgSqNum;
+    record.utcOffset = m_utcOffset;
+    record.symbol = symbol;
+    record.msgType = msgType;
+    record.tradingStatus = tradingStatus;
+
+    if (m_output)
     {
-        throw std::invalid_argument("Binary file is not open for writing.\n");
+        // Dropped if the export thread failed, stop_export_stage() reports it
+        m_output->ring.push({record, &m_bboSymbols[symbol], m_flushOrder});
+        return;
     }
 
-    time_stamp_tostring();
-    // Serialize data in binary format
-    // Assuming m_date and m_Time are null-terminated strings
-    m_binaryOutfile.write(reinterpret_cast<const char*>(m_Time), sizeof(m_Time));
+    export_BBO(record, m_bboSymbols[symbol], 0);
+}
+
+namespace
+{
+    constexpr uint32_t NoSymbol = UINT32_MAX;
+}
 
-    m_binaryOutfile.write(reinterpret_cast<const char*>(&m_timeRef), sizeof(m_timeRef));
-    m_binaryOutfile.write(reinterpret_cast<const char*>(&m_timeOffset), sizeof(m_timeOffset));
-    m_binaryOutfile.write(reinterpret_cast<const char*>(&m_pktSqNum), sizeof(m_pktSqNum));
-    m_binaryOutfile.write(reinterpret_cast<const char*>(&m_msgSqNum), sizeof(m_msgSqNum));
-    m_binaryOutfile.write(reinterpret_cast<const char*>(&msgType), sizeof(msgType));
+void DataExporter::export_BBO(BBORecord record, const std::pair<Symbol, std::string>& symbol, std::size_t source)
+{
+    // Records number their symbol in the dictionary of the exporter that made them, the file in the order of
+    // the first records. With a single source both are the same.
+    std::vector<uint32_t>& symbols = m_symbolMaps[source];
+    if (record.symbol >= symbols.size())
+        symbols.resize(record.symbol + 1, NoSymbol);
+    if (symbols[record.symbol] == NoSymbol)
+    {
+        symbols[record.symbol] = static_cast<uint32_t>(m_exportSymbols.size());
+        m_exportSymbols.push_back(symbol);
+#ifdef MBO_WITH_PARQUET
+        if (m_parquetWriter)
+            m_parquetWriter->add_symbol(symbol.second);
+#endif
+    }
+    record.symbol = symbols[record.symbol];
+
+    if (!bbo_open())
+    {
+        // The temporary name only keeps the days running at once apart: the date of the record will do (with
+        // --shards m_date belongs to the decoder until the export stage stops)
+        render_time_prefix(bbo_local_time(record) / 1'000'000'000);
+        open_bbo({m_timePrefix, 10});
+    }
+
+    auto start = m_timed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+    switch (m_bboFormat)
+    {
+    case BBOFormat::CSV:
+        write_BBO_to_csv(record, symbol.second);
+        break;
+    case BBOFormat::Binary:
+        m_bboWriter.sputn(reinterpret_cast<const char*>(&record), sizeof(record));
+        break;
+    case BBOFormat::Parquet:
+#ifdef MBO_WITH_PARQUET
+        m_parquetWriter->append(record.timestamp, record.utcOffset, record.pktSeqNum, record.msgSeqNum, record.msgType,
+                                record.symbol, record.bidPrice, record.bidQuantity, record.askPrice, record.askQuantity, record.tradingStatus);
+#endif
+        break;
+    }
 
-    // Write symbol length and content
-    uint32_t symbolLength = static_cast<uint32_t>(symbol.size());
-    m_binaryOutfile.write(reinterpret_cast<const char*>(&symbolLength), sizeof(symbolLength));
-    m_binaryOutfile.write(symbol.data(), symbolLength);
+    ++m_bboRecords;
+    if (m_timed)
+        m_bboFormatNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
 
-    // Write prices and quantities
-    double bidPriceConverted = static_cast<double>(bidPrice) * 10e-3;
-    double askPriceConverted = static_cast<double>(askPrice) * 10e-3;
+void DataExporter::start_export_stage(std::size_t ringSize, std::size_t streams)
+{
+    for (std::size_t i = 0; i < streams; ++i)
+        m_exportStreams.push_back(std::make_unique<BBOStream>(ringSize, &m_exportBell));
+    m_symbolMaps.resize(streams);
+    if (streams == 1)
+        m_output = m_exportStreams.front().get();
 
-    m_binaryOutfile.write(reinterpret_cast<const char*>(&bidPriceConverted), sizeof(bidPriceConverted));
-    m_binaryOutfile.write(reinterpret_cast<const char*>(&bidQuantity), sizeof(bidQuantity));
-    m_binaryOutfile.write(reinterpret_cast<const char*>(&askPriceConverted), sizeof(askPriceConverted));
-    m_binaryOutfile.write(reinterpret_cast<const char*>(&askQuantity), sizeof(askQuantity));
-    m_binaryOutfile.write(reinterpret_cast<const char*>(&tradingStatus), sizeof(tradingStatus));
+    m_exportThread = std::thread(&DataExporter::export_loop, this);
+}
+
+void DataExporter::export_loop() noexcept
+{
+    auto start = std::chrono::steady_clock::now();
+    try
+    {
+        if (m_exportStreams.size() == 1)
+        {
+            SpscRing<BBOUpdate>& ring = m_exportStreams.front()->ring;
+            BBOUpdate update{};
+            while (ring.pop(update))
+                export_BBO(update.record, *update.symbol, 0);
+            m_exportWaitNs = static_cast<uint64_t>(ring.consumer_wait_ms() * 1e6);
+        }
+        else
+        {
+            merge_streams();
+        }
+    }
+    catch (...)
+    {
+        m_exportError = std::current_exception();
+        for (auto& stream : m_exportStreams)
+            stream->ring.cancel();
+    }
+    m_exportNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Each stream is in sequence order, so the next record of the file is the smallest head. It can only be written
+// once no stream without a head can still produce a smaller one. A producer that applied every event it was
+// handed produces nothing up to where the decoder is, a busy one nothing up to the last event it applied.
+// The export thread sleeps until a record, an applied event or the decoder moves one of those bounds. Records
+// of the same message (conflated at the end of a transaction) come out in the order the transaction first
+// touched their books, as a single book stage flushes them. A hold keeps the records from a sequence number
+// until every stream has a head or is finished.
+void DataExporter::merge_streams()
+{
+    enum class Head : uint8_t { Empty, Full, Finished };
+
+    std::size_t count = m_exportStreams.size();
+    std::vector<BBOUpdate> heads(count);
+    std::vector<Head> state(count, Head::Empty);
+    std::size_t finished = 0;
+
+    // Writes the next record if it is known, returns false if nothing moved
+    auto step = [&]
+    {
+        bool moved = false;
+        // Decoder first, then each producer: a pop that fails after them proves the stream has nothing up to its bound
+        uint64_t decodedThrough = m_decodedThrough.load(std::memory_order_acquire);
+        std::size_t next = count;
+        uint64_t bound = UINT64_MAX;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            BBOStream& stream = *m_exportStreams[i];
+            if (state[i] == Head::Empty)
+            {
+                uint64_t handed = stream.handedThrough.load(std::memory_order_acquire);
+                uint64_t applied = stream.appliedThrough.load(std::memory_order_acquire);
+                if (stream.ring.try_pop(heads[i]))
+                {
+                    state[i] = Head::Full;
+                    moved = true;
+                }
+                else if (stream.ring.drained())
+                {
+                    state[i] = Head::Finished;
+                    ++finished;
+                    moved = true;
+                }
+                else
+                {
+                    bound = std::min(bound, applied >= handed ? std::max(decodedThrough, applied) : applied);
+                }
+            }
+            if (state[i] == Head::Full && (next == count || std::pair{heads[i].record.msgSeqNum, heads[i].flushOrder} <
+                                                             std::pair{heads[next].record.msgSeqNum, heads[next].flushOrder}))
+                next = i;
+        }
+        // A stream without a head may still add to a held flush. Read after the pops: a flushed record comes
+        // with its hold.
+        if (bound != UINT64_MAX)
+            bound = std::min(bound, m_heldFrom.load(std::memory_order_acquire) - 1);
+
+        if (next != count && heads[next].record.msgSeqNum <= bound)
+        {
+            export_BBO(heads[next].record, *heads[next].symbol, next);
+            state[next] = Head::Empty;
+            moved = true;
+        }
+        return moved || finished == count;
+    };
+
+    while (finished < count)
+    {
+        if (!step())
+            m_exportWaitNs += m_exportBell.wait(step);
+    }
+}
+
+void DataExporter::stop_export_stage()
+{
+    if (!m_exportThread.joinable())
+        return;
+
+    for (auto& stream : m_exportStreams)
+        stream->ring.close();
+    m_exportThread.join();
+    m_output = nullptr;
+    if (m_exportError)
+        std::rethrow_exception(std::exchange(m_exportError, nullptr));
+}
+
+std::size_t DataExporter::export_streams() const noexcept
+{
+    return m_exportStreams.size();
+}
+
+DataExporter::BBOStream& DataExporter::export_stream(std::size_t i) noexcept
+{
+    return *m_exportStreams[i];
+}
+
+const DataExporter::BBOStream& DataExporter::export_stream(std::size_t i) const noexcept
+{
+    return *m_exportStreams[i];
+}
+
+double DataExporter::export_wait_ms() const noexcept
+{
+    return m_exportWaitNs / 1e6;
+}
+
+void DataExporter::forward_to(BBOStream* stream) noexcept
+{
+    m_output = stream;
+    m_forwarding = true;
+}
+
+void DataExporter::set_decoded_through(uint64_t msgSeqNum) noexcept
+{
+    m_decodedThrough.store(msgSeqNum, std::memory_order_release);
+    m_exportBell.ring();
+}
+
+void DataExporter::hold_from(uint64_t msgSeqNum) noexcept
+{
+    m_heldFrom.store(msgSeqNum, std::memory_order_release);
+}
+
+double DataExporter::export_stage_ms() const noexcept
+{
+    return m_exportNs / 1e6;
+}
+
+uint64_t DataExporter::bbo_records() const noexcept
+{
+    return m_bboRecords;
+}
+
+double DataExporter::bbo_format_ms() const noexcept
+{
+    return m_bboFormatNs / 1e6;
+}
+
+void DataExporter::write_BBO_to_csv(const BBORecord& record, const std::string& symbol) noexcept
+{
+    uint64_t local = bbo_local_time(record);
+    uint64_t second = local / 1'000'000'000;
+    if (second != m_prefixSecond)
+        render_time_prefix(second);
+
+    // Time,PktSeqNum,MsgSeqNum,MsgType, | Symbol | ,BidPrice,BidQuantity,AskPrice,AskQuantity,TradingStatus
+    char head[96];
+    char* p = std::copy_n(m_timePrefix, m_timePrefixSize, head);
+    uint32_t nanos = static_cast<uint32_t>(local % 1'000'000'000);
+    for (int i = 8; i >= 0; --i, nanos /= 10) // %09u
+        p[i] = static_cast<char>('0' + nanos % 10);
+    p += 9;
+    *p++ = ',';
+    p = std::to_chars(p, p + MaxDigits, record.pktSeqNum).ptr;
+    *p++ = ',';
+    p = std::to_chars(p, p + MaxDigits, record.msgSeqNum).ptr;
+    *p++ = ',';
+    *p++ = record.msgType;
+    *p++ = ',';
+    m_bboWriter.sputn(head, p - head);
+
+    m_bboWriter.sputn(symbol.data(), static_cast<std::streamsize>(symbol.size()));
+
+    char tail[96];
+    p = tail;
+    *p++ = ',';
+    p = bbo_price_to_chars(p, p + MaxDigits, record.bidPrice);
+    *p++ = ',';
+    p = std::to_chars(p, p + MaxDigits, record.bidQuantity).ptr;
+    *p++ = ',';
+    p = bbo_price_to_chars(p, p + MaxDigits, record.askPrice);
+    *p++ = ',';
+    p = std::to_chars(p, p + MaxDigits, record.askQuantity).ptr;
+    *p++ = ',';
+    *p++ = static_cast<char>(record.tradingStatus);
+    *p++ = '\n';
+    m_bboWriter.sputn(tail, p - tail);
+}
+
+uint64_t DataExporter::bbo_timestamp() const noexcept
+{
+    return (m_midnight + m_timeRef) * 1'000'000'000ull + m_timeOffset;
+}
+
+void DataExporter::render_time_prefix(uint64_t second) noexcept
+{
+    std::time_t time = static_cast<std::time_t>(second);
+    std::tm tm{};
+    gmtime_r(&time, &tm);
+
+    int size = std::snprintf(m_timePrefix, sizeof(m_timePrefix), "%04d-%02d-%02d %02d:%02d:%02d.", tm.tm_year + 1900,
+                             tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+    m_timePrefixSize = std::min(static_cast<std::size_t>(std::max(size, 0)), sizeof(m_timePrefix) - 1);
+    m_prefixSecond = second;
 }
 
 // Function to convert currentTradedate, currentTimeInSecs, and timeOffset to a timestamp string
@@ -192,34 +523,103 @@ void DataExporter::symbol_tostring(const Symbol& symbol, FuturesInstrumentDefini
         }
 }
 
-void DataExporter::flush_csv_buffer()
+std::string DataExporter::bbo_filename(std::string_view date) const
 {
-    std::string output_filename = "../bbo-" + std::string(m_date) + ".csv";
-    std::ofstream outfile;
-    outfile.open(output_filename, std::ios::out);
+    static constexpr const char* extensions[] = {".csv", ".bin", ".parquet"};
+    return "../bbo-" + std::string(date) + extensions[static_cast<int>(m_bboFormat)];
+}
 
-    if (!outfile.is_open()) 
+bool DataExporter::bbo_open() const noexcept
+{
+#ifdef MBO_WITH_PARQUET
+    if (m_parquetWriter)
+        return m_parquetWriter->is_open();
+#endif
+    return m_bboWriter.is_open();
+}
+
+void DataExporter::open_bbo(std::string_view date)
+{
+    static constexpr std::string_view header = "Time,PktSeqNum,MsgSeqNum,MsgType,Symbol,BidPrice,BidQuantity,AskPrice,AskQuantity,TradingStatus\n";
+
+    // Written under a temporary name until finish() knows the date of the day
+    m_bboFilename = bbo_filename(date) + ".part";
+    switch (m_bboFormat)
+    {
+    case BBOFormat::CSV:
+        m_bboWriter.open(m_bboFilename);
+        m_bboWriter.sputn(header.data(), static_cast<std::streamsize>(header.size()));
+        break;
+    case BBOFormat::Binary:
     {
-        throw std::ios_base::failure("Failed to open file: " + output_filename);
+        // Blank until finish_binary_bbo: an unfinished file is rejected by BBOReader
+        const char blank[sizeof(BBOFileHeader)] = {};
+        m_bboWriter.open(m_bboFilename);
+        m_bboWriter.sputn(blank, sizeof(blank));
+        break;
     }
+    case BBOFormat::Parquet:
+#ifdef MBO_WITH_PARQUET
+        m_parquetWriter->open(m_bboFilename);
+#endif
+        break;
+    }
+}
 
-    outfile << "Time,PktSeqNum,MsgSeqNum,MsgType,Symbol,BidPrice,BidQuantity,AskPrice,AskQuantity,TradingStatus\n";
-    outfile << m_bboBuffer.str();
-    m_bboBuffer.str("");  // Clear the buffer
-    m_bboBuffer.clear();  // Reset error flags
+void DataExporter::flush_bbo()
+{
+    // A day without records still gets its (header only) file
+    if (!bbo_open())
+        open_bbo(m_date);
 
-    if (outfile.is_open()) 
+    switch (m_bboFormat)
     {
-        outfile.close();
+    case BBOFormat::CSV:
+        m_bboWriter.close();
+        break;
+    case BBOFormat::Binary:
+        finish_binary_bbo();
+        break;
+    case BBOFormat::Parquet:
+#ifdef MBO_WITH_PARQUET
+        m_parquetWriter->close();
+#endif
+        break;
     }
 }
 
-void DataExporter::flush_binary_buffer()
+void DataExporter::finish_binary_bbo()
 {
-    if (m_binaryOutfile.is_open()) 
+    uint32_t nameOffset = 0;
+    for (const auto& [symbol, name] : m_exportSymbols)
     {
-        m_binaryOutfile.flush();
+        BBOSymbolEntry entry{};
+        std::memcpy(entry.symbol, symbol.symbol, sizeof(entry.symbol));
+        entry.nameSize = static_cast<uint16_t>(name.size());
+        entry.nameOffset = nameOffset;
+        nameOffset += entry.nameSize;
+        m_bboWriter.sputn(reinterpret_cast<const char*>(&entry), sizeof(entry));
     }
+    for (const auto& [symbol, name] : m_exportSymbols)
+        m_bboWriter.sputn(name.data(), static_cast<std::streamsize>(name.size()));
+
+    m_bboWriter.close();
+
+    BBOFileHeader header{};
+    std::memcpy(header.magic, BBOFileHeader::Magic, sizeof(header.magic));
+    header.version = BBOFileHeader::CurrentVersion;
+    header.recordSize = sizeof(BBORecord);
+    header.recordCount = m_bboRecords;
+    header.symbolOffset = sizeof(BBOFileHeader) + m_bboRecords * sizeof(BBORecord);
+    header.symbolCount = static_cast<uint32_t>(m_exportSymbols.size());
+    header.namesOffset = header.symbolOffset + m_exportSymbols.size() * sizeof(BBOSymbolEntry);
+    for (const auto& [symbol, name] : m_exportSymbols)
+        header.namesSize += name.size();
+
+    std::fstream outfile(m_bboFilename, std::ios::in | std::ios::out | std::ios::binary);
+    outfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!outfile)
+        throw std::ios_base::failure("Failed to write the header of " + m_bboFilename);
 }
 
 void DataExporter::orderbook_printer(const std::string& symbol, const std::string& time)
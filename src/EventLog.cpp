@@ -0,0 +1,142 @@
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <ios>
+#include <stdexcept>
+
+#include "EventLog.hpp"
+
+EventLogSource EventLogSource::of(const std::string& pcapFile, std::optional<DayRange> range)
+{
+    auto mtime = std::filesystem::last_write_time(pcapFile);
+    return {std::filesystem::file_size(pcapFile),
+            std::chrono::duration_cast<std::chrono::nanoseconds>(mtime.time_since_epoch()).count(),
+            range.value_or(DayRange{0, 0})};
+}
+
+std::string EventLogSource::log_filename(const std::string& pcapFile, std::optional<DayRange> range)
+{
+    return range ? std::format("{}.{}-{}.l3", pcapFile, range->begin, range->end) : pcapFile + ".l3";
+}
+
+EventLogWriter::EventLogWriter()
+    : m_writer{}, m_filename{}, m_source{}, m_definitions{}, m_eventCount{0}, m_clock{}
+{
+}
+
+void EventLogWriter::open(const std::string& filename, const EventLogSource& source)
+{
+    m_writer.open(filename);
+    m_filename = filename;
+    m_source = source;
+    m_definitions.clear();
+    m_eventCount = 0;
+    m_clock = {};
+
+    // Blank until close()
+    const char blank[sizeof(EventLogHeader)] = {};
+    m_writer.sputn(blank, sizeof(blank));
+}
+
+bool EventLogWriter::is_open() const noexcept
+{
+    return m_writer.is_open();
+}
+
+void EventLogWriter::close()
+{
+    if (!is_open())
+        return;
+
+    m_writer.sputn(reinterpret_cast<const char*>(m_definitions.data()), static_cast<std::streamsize>(m_definitions.size()));
+    m_writer.close();
+
+    EventLogHeader header{};
+    std::memcpy(header.magic, EventLogHeader::Magic, sizeof(header.magic));
+    header.version = EventLogHeader::CurrentVersion;
+    header.eventSize = sizeof(L3Event);
+    header.sourceSize = m_source.size;
+    header.sourceMtime = m_source.mtime;
+    header.rangeBegin = m_source.range.begin;
+    header.rangeEnd = m_source.range.end;
+    header.eventCount = m_eventCount;
+    header.definitionsSize = m_definitions.size();
+
+    std::fstream outfile(m_filename, std::ios::in | std::ios::out | std::ios::binary);
+    outfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!outfile)
+        throw std::ios_base::failure("Failed to write the header of " + m_filename);
+}
+
+void EventLogWriter::append(L3Event event, uint64_t pktSeqNum, uint64_t msgSeqNum, uint32_t timeOffset)
+{
+    m_clock.stamp(event, pktSeqNum, msgSeqNum, timeOffset);
+    m_writer.sputn(reinterpret_cast<const char*>(&event), sizeof(event));
+    ++m_eventCount;
+}
+
+void EventLogWriter::append_instrument(Order::BookIndex book, const u_char* message, std::size_t size,
+                                       uint64_t pktSeqNum, uint64_t msgSeqNum, uint32_t timeOffset)
+{
+    L3Event event{};
+    event.type = L3EventType::Instrument;
+    event.book = book;
+    event.orderId = m_definitions.size();
+    event.quantity = static_cast<uint32_t>(size);
+    m_definitions.insert(m_definitions.end(), message, message + size);
+
+    append(event, pktSeqNum, msgSeqNum, timeOffset);
+}
+
+uint64_t EventLogWriter::size() const noexcept
+{
+    return m_eventCount;
+}
+
+EventLogReader::EventLogReader(const std::string& filename)
+    : m_file{filename}, m_header{}, m_events{}, m_definitions{}
+{
+    if (m_file.size() < sizeof(EventLogHeader))
+        throw std::runtime_error("Error: " + filename + " is too small to be an event log");
+
+    std::memcpy(&m_header, m_file.data(), sizeof(m_header));
+
+    // A writer that did not finish leaves a zeroed header
+    if (std::memcmp(m_header.magic, EventLogHeader::Magic, sizeof(m_header.magic)) != 0)
+        throw std::runtime_error("Error: " + filename + " is not a complete event log");
+    if (m_header.version != EventLogHeader::CurrentVersion || m_header.eventSize != sizeof(L3Event))
+        throw std::runtime_error("Error: " + filename + " has an unsupported event log version " + std::to_string(m_header.version));
+
+    std::size_t available = m_file.size() - sizeof(EventLogHeader);
+    if (m_header.eventCount > available / sizeof(L3Event) ||
+        m_header.definitionsSize != available - m_header.eventCount * sizeof(L3Event))
+    {
+        throw std::runtime_error("Error: " + filename + " is truncated");
+    }
+
+    // The mapping is page aligned and the header keeps the events 8 byte aligned: they are used in place
+    const u_char* data = m_file.data() + sizeof(EventLogHeader);
+    m_events = {reinterpret_cast<const L3Event*>(data), static_cast<std::size_t>(m_header.eventCount)};
+    m_definitions = {data + m_header.eventCount * sizeof(L3Event), static_cast<std::size_t>(m_header.definitionsSize)};
+}
+
+std::span<const L3Event> EventLogReader::events() const noexcept
+{
+    return m_events;
+}
+
+std::span<const u_char> EventLogReader::definition(const L3Event& event) const
+{
+    if (event.orderId > m_definitions.size() || event.quantity > m_definitions.size() - event.orderId)
+        throw std::out_of_range("Event log definition out of bounds");
+
+    return m_definitions.subspan(event.orderId, event.quantity);
+}
+
+bool EventLogReader::built_from(const EventLogSource& source) const noexcept
+{
+    return m_header.sourceSize == source.size && m_header.sourceMtime == source.mtime &&
+           m_header.rangeBegin == source.range.begin && m_header.rangeEnd == source.range.end;
+}
@@ -1,27 +1,22 @@
+#include <cassert>
 #include <format>
-#include <iostream>
 #include <stdexcept>
 
 #include "Order.hpp"
+#include "PriceLevel.hpp"
 
-Order::Order(ID id, const Symbol& symbol, Price price, Quantity quantity, Side side) noexcept
-    : m_symbol{symbol}, m_id{id}, m_price{price}, m_initialQty{quantity}, 
-      m_remainingQty{quantity}, m_tradableQty{quantity}, m_side{side}
+Order::Order(Handle handle, BookIndex book, Quantity quantity) noexcept
+    : m_prev{nullptr}, m_next{nullptr}, m_level{nullptr}, m_handle{handle}, m_remainingQty{quantity}, m_book{book}
 {}
 
-Order::ID Order::get_id() const noexcept
+Order::Handle Order::get_handle() const noexcept
 {
-    return m_id;
+    return m_handle;
 }
 
-const Symbol& Order::get_symbol() const noexcept
+Order::BookIndex Order::get_book() const noexcept
 {
-    return m_symbol;
-}
-
-Order::Quantity Order::get_initial_quantity() const noexcept
-{
-    return m_initialQty;
+    return m_book;
 }
 
 Order::Quantity Order::get_remaining_quantity() const noexcept
@@ -29,19 +24,21 @@ Order::Quantity Order::get_remaining_quantity() const noexcept
     return m_remainingQty;
 }
 
-Order::Quantity Order::get_tradable_quantity() const noexcept
+Order::Side Order::get_side() const noexcept
 {
-    return m_tradableQty;
+    assert(m_level != nullptr && "only a resting order has a side");
+    return m_level->get_side();
 }
 
-Order::Side Order::get_side() const noexcept
+Order::Price Order::get_price() const noexcept
 {
-    return m_side;
+    assert(m_level != nullptr && "only a resting order has a price");
+    return m_level->get_price();
 }
 
-Order::Price Order::get_price() const noexcept
+PriceLevel* Order::get_level() const noexcept
 {
-    return m_price;
+    return m_level;
 }
 
 bool Order::is_filled() const noexcept
@@ -52,40 +49,17 @@ bool Order::is_filled() const noexcept
 void Order::fill(Quantity quantity)
 {
     if (quantity > m_remainingQty)
-        throw std::logic_error(std::format("Cannot fill order {} by an amount greater than its remaining quantity! (remaining quantity: {})", m_id, m_remainingQty));
+        throw std::logic_error(std::format("Cannot fill order by an amount greater than its remaining quantity! (remaining quantity: {})", m_remainingQty));
 
     m_remainingQty -= quantity;
 }
 
-void Order::print_info() const
+void Order::fill_unchecked(Quantity quantity) noexcept
 {
-    std::string side;
-    switch (m_side) 
-    {
-        case Side::Buy: 
-            side = "Buy";
-            break;
-        case Side::Sell: 
-            side = "Sell";
-            break;
-    }
-
-    std::string type = "Limit Order";
+    m_remainingQty -= quantity;
+}
 
-    std::cout << std::format(
-        "-- LimitOrder Information --\n"
-        "{:<20} {}\n"  // Align left in 20 spaces
-        "{:<20} {}\n"
-        "{:<20} {}\n"
-        "{:<20} {}\n"
-        "{:<20} {}\n"
-        "{:<20} {}\n"
-        "{:<20} {}\n",
-        "ID:", m_id, 
-        "Symbol:", std::string(reinterpret_cast<const char*>(m_symbol.symbol)),
-        "Type:", type,                                           
-        "Side:", side,                      
-        "Price:", m_price,                   
-        "Initial Quantity:", m_initialQty,        
-        "Remaining Quantity:", m_remainingQty) << std::endl;     
-}
\ No newline at end of file
+void Order::modify(Quantity quantity) noexcept
+{
+    m_remainingQty = quantity;
+}
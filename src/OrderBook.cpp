@@ -4,13 +4,13 @@
 #include <chrono>
 
 #include "cfepitch.h"
-#include "Config.hpp"
 #include "OrderBook.hpp"
 #include "OrderStore.hpp"
 
-OrderBook::OrderBook(const Symbol& symbol, uint16_t contractSize, uint64_t tickSize, OrderStore* orderstore, DataExporter* dataExporter)
-    : m_asks{}, m_bids{}, m_symbol{symbol}, m_tickSize{tickSize}, m_orderstore{orderstore}, m_dataExporter{dataExporter},
-      m_contractSize{contractSize}, m_tradingStatus{'S'}
+OrderBook::OrderBook(const Symbol& symbol, Order::BookIndex index, uint16_t contractSize, uint64_t tickSize, OrderStore* orderstore, DataExporter* dataExporter,
+                     LadderType ladderType)
+    : m_asks{ladderType, tickSize}, m_bids{ladderType, tickSize}, m_symbol{symbol}, m_index{index}, m_tickSize{tickSize}, m_orderstore{orderstore}, m_dataExporter{dataExporter},
+      m_contractSize{contractSize}, m_tradingStatus{'S'}, m_bbo{0, 0, 0, 0}, m_bboSymbol{NoBBOSymbol}, m_pendingBBO{0}
 {
 }
 
@@ -21,9 +21,7 @@ std::pair<Order::Price, Order::Quantity> OrderBook::get_best_bid() const noexcep
         return {0,0};
     }
 
-    auto best_bid = m_bids.begin();
-
-    return {best_bid->first, best_bid->second.first};
+    return {m_bids.best_price(), m_bids.best_level().get_quantity()};
 }
 
 std::pair<Order::Price, Order::Quantity> OrderBook::get_best_ask() const noexcept
@@ -33,19 +31,17 @@ std::pair<Order::Price, Order::Quantity> OrderBook::get_best_ask() const noexcep
         return {0,0};
     }
 
-    auto best_ask = m_asks.begin();
-    
-    return {best_ask->first, best_ask->second.first};
+    return {m_asks.best_price(), m_asks.best_level().get_quantity()};
 }
 
 Order::Price OrderBook::get_best_bid_price() const noexcept
 {
-    return m_bids.begin()->first;
+    return m_bids.empty() ? 0 : m_bids.best_price();
 }
 
 Order::Price OrderBook::get_best_ask_price() const noexcept
 {
-    return m_asks.begin()->first;
+    return m_asks.empty() ? 0 : m_asks.best_price();
 }
 
 OrderBook::BBO OrderBook::get_bbo() const noexcept
@@ -58,12 +54,12 @@ OrderBook::BBO OrderBook::get_bbo() const noexcept
 
 OrderBook::Bids OrderBook::get_bids() const noexcept
 {
-    return m_bids;
+    return m_bids.snapshot();
 }
 
 OrderBook::Asks OrderBook::get_asks() const noexcept
 {
-    return m_asks;
+    return m_asks.snapshot();
 }
 
 OrderBook::TradingStatus OrderBook::get_trading_status() const noexcept
@@ -71,6 +67,16 @@ OrderBook::TradingStatus OrderBook::get_trading_status() const noexcept
     return m_tradingStatus;
 }
 
+const Symbol& OrderBook::get_symbol() const noexcept
+{
+    return m_symbol;
+}
+
+Order::BookIndex OrderBook::get_index() const noexcept
+{
+    return m_index;
+}
+
 bool OrderBook::bids_empty() const noexcept
 {
     return m_bids.empty();
@@ -93,7 +99,8 @@ void OrderBook::print_book() const
     }
     else
     { 
-        for (auto&& [price, orders] : std::views::reverse(m_asks)) 
+        const Asks asks = get_asks();
+        for (auto&& [price, orders] : std::views::reverse(asks)) 
         {
             std::cout << std::format("{:<10}", price);
             for (const auto& order : orders.second)
@@ -111,7 +118,7 @@ void OrderBook::print_book() const
     }
     else
     {
-        for (const auto& [price, orders] : m_bids) 
+        for (const auto& [price, orders] : get_bids()) 
         {
             std::cout << std::format("{:<10}", price);
             for (const auto& order : orders.second)
@@ -125,240 +132,111 @@ void OrderBook::print_book() const
     std::cout << std::endl;
 }
 
+template<typename Policy>
 void OrderBook::add_order(Order::ID id, Order::Price price, Order::Quantity quantity, Order::Side side)
 {
-    if (m_orderstore->contains(id))
+    auto [order_ptr, inserted] = m_orderstore->try_add_order(id, m_index, quantity);
+    if (!inserted)
     {
         throw std::invalid_argument("You cannot add an order with the same id as one already in the book");
     }
 
-    Order* order_ptr = m_orderstore->add_order(id, m_symbol, price, quantity, side);
+    // Constant false without BBO tracking
+    bool top = Policy::TrackBBO && touches_top(side, price);
 
-    OrderBook::BBO currentBBO{get_bbo()};
+    PriceLevel& level = side == Order::Side::Buy ? m_bids[price] : m_asks[price];
+    level.add_quantity(quantity);
+    level.push_back(order_ptr);
 
-    if (side == Order::Side::Buy)
-    {        
-        m_bids[price].first += quantity;
-        m_bids[price].second.push_back(order_ptr);
-    }
-
-    else
-    {
-        m_asks[price].first += quantity;
-        m_asks[price].second.push_back(order_ptr);
-    }
-
-    auto newBBO = get_bbo();
-
-    // Check if the BBO option is set and if the added order has affected the BBO
-    if (Config::getInstance().bbo() && currentBBO != newBBO)
-    {
-        const auto& [bidPx, bidQty, askPx, askQty] = newBBO;
-        m_dataExporter->store_BBO_records('A', m_symbol,  
-                bidPx, bidQty, askPx, askQty, m_tradingStatus);
-    }
+    if (top)
+        top_touched<Policy>('A');
 }
 
-void OrderBook::cancel_order(Order::ID order_id)
+template<typename Policy>
+void OrderBook::cancel_order(const OrderStore::OrderRef& ref)
 {
-    if (!m_orderstore->contains(order_id))
-    {
-        throw std::invalid_argument(std::format("The order with ID {} does not exist in the orderbook", order_id));
-    }
-
-    OrderBook::BBO currentBBO{get_bbo()};
-
-    const Order& order = m_orderstore->operator[](order_id);  // same as (*m_orderstore)[order_id]
-    auto price = order.get_price();
-
-    if (order.get_side() == Order::Side::Buy)
-    {
-        if (m_bids[price].second.size() == 1)
-        {
-            m_bids.erase(price);
-            m_orderstore->erase(order_id);
-        }
-        else
-        {
-            m_bids[price].first -= order.get_remaining_quantity();
-            std::erase_if(m_bids[price].second, 
-                [&order, &order_id](const auto& bid){ return bid->get_id() == order_id;});
-        }
-    }
-    else
-    {
-        if (m_asks[price].second.size() == 1)
-        {
-            m_asks.erase(price);
-            m_orderstore->erase(order_id);
-        }
-        else
-        {
-            m_asks[price].first -= order.get_remaining_quantity();
-            std::erase_if(m_asks[price].second, 
-                [&order, &order_id](const auto& ask){ return ask->get_id() == order_id;});
-        }
-    }
+    bool top = Policy::TrackBBO && touches_top(ref.order->get_side(), ref.order->get_price());
 
-    auto newBBO = get_bbo();
+    remove_from_level(ref, ref.order->get_remaining_quantity());
 
-    // Check if the BBO option is set and if the added order has affected the BBO
-    if (Config::getInstance().bbo() && currentBBO != newBBO)
-    {
-        const auto& [bidPx, bidQty, askPx, askQty] = newBBO;
-        m_dataExporter->store_BBO_records('D', m_symbol, 
-                bidPx, bidQty, askPx, askQty, m_tradingStatus);
-    }
-
-    m_orderstore->erase(order_id);
+    if (top)
+        top_touched<Policy>('D');
 }
 
-void OrderBook::modify_order(Order::ID order_id, Order::Price new_price, Order::Quantity new_qty)
+template<typename Policy>
+void OrderBook::modify_order(const OrderStore::OrderRef& ref, Order::Price new_price, Order::Quantity new_qty)
 {
-    if (!m_orderstore->contains(order_id))
-    {
-        throw std::invalid_argument(std::format("The order with ID {} does not exist in the orderbook", order_id));
-    }
-    OrderBook::BBO currentBBO{get_bbo()};
-
-    Order& old_order = m_orderstore->operator[](order_id);
+    Order& old_order = *ref.order;
     auto old_price = old_order.get_price();
+    // Leaving the best level or moving to a price at or better than the best
+    bool top = Policy::TrackBBO &&
+        (touches_top(old_order.get_side(), old_price) || touches_top(old_order.get_side(), new_price));
 
     if (new_price == old_price && new_qty < old_order.get_remaining_quantity())
     {
-        reduce_internal(order_id, old_order.get_remaining_quantity() - new_qty); 
+        reduce_internal(old_order, old_order.get_remaining_quantity() - new_qty); 
     }
     else
     {
-        Order::Side old_side = old_order.get_side();
-        cancel_internal(order_id);
-        add_internal(order_id, new_price, new_qty, old_side);
+        move_internal(old_order, new_price, new_qty);
     }
 
-    auto newBBO = get_bbo();
-
-    // Check if the BBO option is set and if the added order has affected the BBO
-    if (Config::getInstance().bbo() && currentBBO != newBBO)
-    {
-        const auto& [bidPx, bidQty, askPx, askQty] = newBBO;
-            m_dataExporter->store_BBO_records('M', m_symbol, 
-                bidPx, bidQty, askPx, askQty, m_tradingStatus);
-    }
+    if (top)
+        top_touched<Policy>('M');
 }
 
-void OrderBook::reduce_order(Order::ID order_id, Order::Quantity cxl_qty)
+template<typename Policy>
+void OrderBook::reduce_order(const OrderStore::OrderRef& ref, Order::Quantity cxl_qty)
 {
-    if (!m_orderstore->contains(order_id))
-    {
-        throw std::invalid_argument(std::format("The order with ID {} does not exist in the orderbook", order_id));
-    }
-
-    OrderBook::BBO currentBBO{get_bbo()};
-
-    Order& order = m_orderstore->operator[](order_id);
-    auto price = order.get_price();
-
-    try
-    {
-        if (order.get_side() == Order::Side::Buy)
-            m_bids[price].first -= cxl_qty;
-        else
-            m_asks[price].first -= cxl_qty;
-        order.fill(cxl_qty);
-    } 
-    catch (const std::logic_error& e)
-    {
-        throw std::logic_error(e.what());
-    }
+    bool top = Policy::TrackBBO && touches_top(ref.order->get_side(), ref.order->get_price());
 
-    auto newBBO = get_bbo();
+    fill<Policy>(*ref.order, cxl_qty);
 
-    // Check if the BBO option is set and if the added order has affected the BBO
-    if (Config::getInstance().bbo() && currentBBO != newBBO) 
-    {
-        const auto& [bidPx, bidQty, askPx, askQty] = newBBO;
-        m_dataExporter->store_BBO_records('R', m_symbol, 
-                bidPx, bidQty, askPx, askQty, m_tradingStatus);
-    }
+    if (top)
+        top_touched<Policy>('R');
 }
 
-
-void OrderBook::execute_order(Order::ID order_id, Order::Quantity executed_qty)
+template<typename Policy>
+void OrderBook::execute_order(const OrderStore::OrderRef& ref, Order::Quantity executed_qty)
 {    
-    if (!m_orderstore->contains(order_id))
-    {
-        throw std::invalid_argument(std::format("The order with ID {} does not exist in the orderbook", order_id));
-    }
-
-    OrderBook::BBO currentBBO{get_bbo()};
-
-    Order& order = m_orderstore->operator[](order_id);
-    auto price = order.get_price();
+    Order& order = *ref.order;
+    bool top = Policy::TrackBBO && touches_top(order.get_side(), order.get_price());
 
     if (order.get_remaining_quantity() == executed_qty) // complete fill
     {
-        if (order.get_side() == Order::Side::Buy)
+        if constexpr (Policy::CheckIntegrity)
         {
-            if (order_id != m_bids[price].second.front()->get_id())
+            if (&order != order.get_level()->front())
             {
                 // This is a data integrity error: order book state fatally wrong
-                throw std::logic_error(std::format("Order id {} is not first in bid queue", order.get_id()));
-            }
-            if (m_bids[price].second.size() == 1)
-            {
-                m_bids.erase(price);
-            } 
-            else
-            {
-                m_bids[price].first -= executed_qty;
-                m_bids[price].second.erase(m_bids[price].second.begin());
-            }
-
-        } 
-        else
-        {
-            if (order_id != m_asks[price].second.front()->get_id())
-            {
-                // This is a data integrity error: order book state fatally wrong
-                throw std::logic_error(std::format("Order id {} is not first in ask queue", order.get_id()));
-            }
-            if (m_asks[price].second.size() == 1)
-            {
-                m_asks.erase(price);
-            } 
-            else
-            {
-                m_asks[price].first -= executed_qty;
-                m_asks[price].second.erase(m_asks[price].second.begin());
+                throw std::logic_error(std::format("Order id {} is not first in {} queue", m_orderstore->cold(order).id,
+                    order.get_side() == Order::Side::Buy ? "bid" : "ask"));
             }
         }
-        // Remove order from orderstore
-        m_orderstore->erase(order_id);
+        remove_from_level(ref, executed_qty);
     }
     else // not a full fill
     {
-        try
-        {
-            if (order.get_side() == Order::Side::Buy)
-                m_bids[price].first -= executed_qty;
-            else
-                m_asks[price].first -= executed_qty;
-            order.fill(executed_qty);
-        } 
-        catch (const std::logic_error& e)
-        {
-            throw std::logic_error(e.what());
-        }
+        fill<Policy>(order, executed_qty);
     }
 
-    auto newBBO = get_bbo();
+    if (top)
+        top_touched<Policy>('E');
+}
 
-    // Check if the BBO option is set and if the added order has affected the BBO
-    if (Config::getInstance().bbo() && currentBBO != newBBO)
+bool OrderBook::bbo_pending() const noexcept
+{
+    return m_pendingBBO != 0;
+}
+
+// Intermediate states of a transaction (e.g. crossed books during a sweep) are never published, and a book
+// that ends the transaction at its starting BBO publishes nothing
+void OrderBook::flush_bbo()
+{
+    if (m_pendingBBO != 0)
     {
-        const auto& [bidPx, bidQty, askPx, askQty] = newBBO;
-        m_dataExporter->store_BBO_records('E', m_symbol, 
-                bidPx, bidQty, askPx, askQty, m_tradingStatus);
+        publish_bbo(m_pendingBBO);
+        m_pendingBBO = 0;
     }
 }
 
@@ -381,66 +259,128 @@ const Order& OrderBook::find_order(Order::ID order_id) const
         throw std::invalid_argument("Order {} not found" + order_id);
 }
 
-// The following functions are required to avoid double counting BBO entries when adding/modifying/reducing an order
-// They are only being used internally and should not be made visible to the user
-void OrderBook::add_internal(Order::ID id, Order::Price price, Order::Quantity quantity, Order::Side side) noexcept
+OrderStore::OrderRef OrderBook::lookup(Order::ID order_id) const
 {
-    Order* order_ptr = m_orderstore->add_order(id, m_symbol, price, quantity, side);
-
-    if (side == Order::Side::Buy)
+    OrderStore::OrderRef ref = m_orderstore->lookup(order_id);
+    if (!ref)
     {
-        m_bids[price].first += quantity;
-        m_bids[price].second.push_back(order_ptr);
+        throw std::invalid_argument(std::format("The order with ID {} does not exist in the orderbook", order_id));
     }
+    return ref;
+}
 
+template<typename Policy>
+void OrderBook::top_touched(char reason)
+{
+    if constexpr (Policy::ConflateBBO)
+        m_pendingBBO = reason; // OrderBookManager flushes it after the message, or at the end of its transaction
     else
+        publish_bbo(reason);
+}
+
+bool OrderBook::touches_top(Order::Side side, Order::Price price) const noexcept
+{
+    if (side == Order::Side::Buy)
+        return m_bids.empty() || price >= m_bids.best_price();
+
+    return m_asks.empty() || price <= m_asks.best_price();
+}
+
+void OrderBook::publish_bbo(char reason)
+{
+    // The top was touched but may be unchanged (e.g. an order losing its priority at the same quantity)
+    auto newBBO = get_bbo();
+    if (newBBO != m_bbo)
     {
-        m_asks[price].first += quantity;
-        m_asks[price].second.push_back(order_ptr);
+        m_bbo = newBBO;
+        const auto& [bidPx, bidQty, askPx, askQty] = newBBO;
+        if (m_bboSymbol == NoBBOSymbol)
+            m_bboSymbol = m_dataExporter->bbo_symbol(m_symbol);
+        m_dataExporter->store_BBO_records(reason, m_bboSymbol, bidPx, bidQty, askPx, askQty, m_tradingStatus);
     }
 }
 
-void OrderBook::cancel_internal(Order::ID order_id) noexcept
+template<typename Policy>
+void OrderBook::fill(Order& order, Order::Quantity quantity)
 {
-    const Order& order = m_orderstore->operator[](order_id);  
-    auto price = order.get_price();
-    if (order.get_side() == Order::Side::Buy)
+    order.get_level()->remove_quantity(quantity);
+    if constexpr (Policy::CheckIntegrity)
     {
-        if (m_bids[price].second.size() == 1)
+        try
+        {
+            order.fill(quantity);
+        } 
+        catch (const std::logic_error& e)
         {
-            m_bids.erase(price);
-            m_orderstore->erase(order_id);
-            return;
+            throw std::logic_error(std::format("Order {}: {}", m_orderstore->cold(order).id, e.what()));
         }
-        
-        m_bids[price].first -= order.get_remaining_quantity();
-        std::erase_if(m_bids[price].second, 
-                [&order, &order_id](const auto& ask){ return ask->get_id() == order_id;});
     }
     else
     {
-        if (m_asks[price].second.size() == 1)
-        {
-            m_asks.erase(price);
-            m_orderstore->erase(order_id);
-            return;
-        }
-
-        m_asks[price].first -= order.get_remaining_quantity();
-        std::erase_if(m_asks[price].second, 
-                [&order, &order_id](const auto& ask){ return ask->get_id() == order_id;});
+        order.fill_unchecked(quantity);
     }
+}
+
+// The following functions are required to avoid double counting BBO entries when modifying an order
+// They are only being used internally and should not be made visible to the user
+void OrderBook::reduce_internal(Order& order, Order::Quantity cxl_qty) noexcept
+{
+    order.get_level()->remove_quantity(cxl_qty);
+    order.fill(cxl_qty);
+}
 
-    m_orderstore->erase(order_id);
+// Moves the order to the back of the queue at its new price, reusing its slot in the order store
+void OrderBook::move_internal(Order& order, Order::Price new_price, Order::Quantity new_qty) noexcept
+{
+    PriceLevel* level = order.get_level();
+    Order::Side side = level->get_side();
+    level->remove_quantity(order.get_remaining_quantity());
+    level->erase(&order);
+    if (level->empty())
+        erase_level(side, level->get_price());
+
+    order.modify(new_qty);
+    OrderStore::ColdOrder& cold = m_orderstore->cold(order);
+    cold.initialQty = cold.tradableQty = new_qty;
+
+    PriceLevel& new_level = side == Order::Side::Buy ? m_bids[new_price] : m_asks[new_price];
+    new_level.add_quantity(new_qty);
+    new_level.push_back(&order);
 }
 
-void OrderBook::reduce_internal(Order::ID order_id, Order::Quantity cxl_qty) noexcept
+// Unlinks an order from its queue in O(1), drops the level if it became empty and erases the order from the store
+void OrderBook::remove_from_level(const OrderStore::OrderRef& ref, Order::Quantity quantity) noexcept
 {
-    Order& order = m_orderstore->operator[](order_id);
+    Order& order = *ref.order;
+    PriceLevel* level = order.get_level();
+    level->remove_quantity(quantity);
+    level->erase(&order);
+    if (level->empty())
+        erase_level(level->get_side(), level->get_price());
+
+    m_orderstore->erase(ref);
+}
 
-    if (order.get_side() == Order::Side::Buy)
-        m_bids[order.get_price()].first -= cxl_qty;
+void OrderBook::erase_level(Order::Side side, Order::Price price) noexcept
+{
+    if (side == Order::Side::Buy)
+        m_bids.erase(price);
     else
-        m_asks[order.get_price()].first -= cxl_qty;
-    order.fill(cxl_qty);
-}
\ No newline at end of file
+        m_asks.erase(price);
+}
+
+// Every policy the parser can select (see with_book_policy)
+#define INSTANTIATE_ORDERBOOK_MUTATIONS(...) \
+    template void OrderBook::add_order<__VA_ARGS__>(Order::ID, Order::Price, Order::Quantity, Order::Side); \
+    template void OrderBook::cancel_order<__VA_ARGS__>(const OrderStore::OrderRef&); \
+    template void OrderBook::modify_order<__VA_ARGS__>(const OrderStore::OrderRef&, Order::Price, Order::Quantity); \
+    template void OrderBook::reduce_order<__VA_ARGS__>(const OrderStore::OrderRef&, Order::Quantity); \
+    template void OrderBook::execute_order<__VA_ARGS__>(const OrderStore::OrderRef&, Order::Quantity);
+
+INSTANTIATE_ORDERBOOK_MUTATIONS(BookPolicy<true, true, false>)
+INSTANTIATE_ORDERBOOK_MUTATIONS(BookPolicy<true, false, false>)
+INSTANTIATE_ORDERBOOK_MUTATIONS(BookPolicy<false, true, false>)
+INSTANTIATE_ORDERBOOK_MUTATIONS(BookPolicy<false, false, false>)
+INSTANTIATE_ORDERBOOK_MUTATIONS(BookPolicy<true, true, true>)
+INSTANTIATE_ORDERBOOK_MUTATIONS(BookPolicy<true, false, true>)
+#undef INSTANTIATE_ORDERBOOK_MUTATIONS
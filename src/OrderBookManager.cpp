@@ -1,62 +1,164 @@
-#include <unordered_map>
+#include <algorithm>
 #include <format>
+#include <limits>
 #include <stdexcept>
 #include <ranges>
 #include <fstream>
 
+#include "Config.hpp"
 #include "OrderBookManager.hpp"
 #include "Order.hpp"
 
 OrderBookManager::OrderBookManager(OrderStore* os, DataExporter* dataExporter) noexcept
-    : m_orderbooks{}, m_orderstore(os), m_dataExporter{dataExporter}
+    : m_orderbooks{}, m_symbolIndex{}, m_orderstore(os), m_dataExporter{dataExporter}, m_orderMessages{0}, m_inTransaction{false}, m_pendingBooks{}
 {
 }
 
-void OrderBookManager::add_orderbook(const Symbol& ob, uint16_t contractSize, uint64_t tickSize) noexcept
+void OrderBookManager::add_orderbook(const Symbol& ob, uint16_t contractSize, uint64_t tickSize)
 {
-    if (m_orderbooks.contains(ob))
+    if (contains(ob))
         return;
-    m_orderbooks.try_emplace(ob, ob, contractSize, tickSize, m_orderstore, m_dataExporter); // Construct orderbook in-place in the map
+    // The last index is L3Event::NoBook
+    if (m_orderbooks.size() >= std::numeric_limits<Order::BookIndex>::max())
+        throw std::length_error("Too many order books for a 16 bit book index");
+
+    auto index = static_cast<Order::BookIndex>(m_orderbooks.size());
+    LadderType ladderType = Config::getInstance().flatLadder() ? LadderType::Flat : LadderType::Map;
+    m_orderbooks.push_back(std::make_unique<OrderBook>(ob, index, contractSize, tickSize, m_orderstore, m_dataExporter, ladderType));
+
+    auto it = std::ranges::lower_bound(m_symbolIndex, ob.key(), {}, &std::pair<uint64_t, Order::BookIndex>::first);
+    m_symbolIndex.insert(it, {ob.key(), index});
 }
 
 void OrderBookManager::remove_orderbook(const Symbol& ob)
 {
-    m_orderbooks.erase(ob);
+    // The index is not reused: messages still naming the book must not reach another one
+    auto it = find_symbol(ob);
+    if (it == m_symbolIndex.end())
+        return;
+
+    // Its resting orders go with it, no order is left pointing at the empty slot. Ids are collected first:
+    // erasing moves the store's index entries.
+    const OrderBook& orderbook = *m_orderbooks[it->second];
+    std::vector<Order::ID> orders;
+    auto collect = [&](const auto& levels)
+    {
+        for (const auto& [price, level] : levels)
+        {
+            for (const Order* order : level.second)
+                orders.push_back(m_orderstore->cold(*order).id);
+        }
+    };
+    collect(orderbook.get_bids());
+    collect(orderbook.get_asks());
+    for (Order::ID id : orders)
+        m_orderstore->erase(id);
+
+    m_orderbooks[it->second].reset();
+    m_symbolIndex.erase(it);
 }
 
+template<typename Policy>
 void OrderBookManager::add_order(Order::ID id, const Symbol& symbol, Order::Price price, Order::Quantity quantity, Order::Side side)
 {
-    m_orderbooks.at(symbol).add_order(id, price, quantity, side);
+    ++m_orderMessages;
+    OrderBook& orderbook = book(symbol);
+    orderbook.add_order<Policy>(id, price, quantity, side);
+    after_mutation<Policy>(orderbook);
 }
 
+template<typename Policy>
+void OrderBookManager::add_order(Order::ID id, Order::BookIndex index, Order::Price price, Order::Quantity quantity, Order::Side side)
+{
+    ++m_orderMessages;
+    OrderBook& orderbook = book(index);
+    orderbook.add_order<Policy>(id, price, quantity, side);
+    after_mutation<Policy>(orderbook);
+}
+
+// The single id lookup of each mutation: the order found carries its book and its level
+template<typename Policy>
 void OrderBookManager::cancel_order(Order::ID order_id)
 {
-    m_orderbooks.at((*m_orderstore)[order_id].get_symbol()).cancel_order(order_id);
+    auto ref = lookup(order_id);
+    OrderBook& orderbook = *m_orderbooks[ref.order->get_book()];
+    orderbook.cancel_order<Policy>(ref);
+    after_mutation<Policy>(orderbook);
 }
 
+template<typename Policy>
 void OrderBookManager::modify_order(Order::ID order_id, Order::Price new_price, Order::Quantity new_qty)
 {
-    m_orderbooks.at((*m_orderstore)[order_id].get_symbol()).modify_order(order_id, new_price, new_qty);
+    auto ref = lookup(order_id);
+    OrderBook& orderbook = *m_orderbooks[ref.order->get_book()];
+    orderbook.modify_order<Policy>(ref, new_price, new_qty);
+    after_mutation<Policy>(orderbook);
 }
 
+template<typename Policy>
 void OrderBookManager::reduce_order(Order::ID order_id, Order::Quantity new_qty)
 {
-    m_orderbooks.at((*m_orderstore)[order_id].get_symbol()).reduce_order(order_id, new_qty);
+    auto ref = lookup(order_id);
+    OrderBook& orderbook = *m_orderbooks[ref.order->get_book()];
+    orderbook.reduce_order<Policy>(ref, new_qty);
+    after_mutation<Policy>(orderbook);
 }
 
+template<typename Policy>
 void OrderBookManager::execute_order(Order::ID order_id, Order::Quantity executed_qty)
 {
-    m_orderbooks.at((*m_orderstore)[order_id].get_symbol()).execute_order(order_id, executed_qty);
+    auto ref = lookup(order_id);
+    OrderBook& orderbook = *m_orderbooks[ref.order->get_book()];
+    orderbook.execute_order<Policy>(ref, executed_qty);
+    after_mutation<Policy>(orderbook);
 }
 
 void OrderBookManager::update_tradingStatus(const Symbol& symbol, OrderBook::TradingStatus tradingStatus)
 {
-    m_orderbooks.at(symbol).update_tradingStatus(tradingStatus);
+    book(symbol).update_tradingStatus(tradingStatus);
+}
+
+void OrderBookManager::update_tradingStatus(Order::BookIndex index, OrderBook::TradingStatus tradingStatus)
+{
+    book(index).update_tradingStatus(tradingStatus);
+}
+
+void OrderBookManager::begin_transaction() noexcept
+{
+    m_inTransaction = true;
+}
+
+void OrderBookManager::end_transaction()
+{
+    m_inTransaction = false;
+    for (auto [index, firstTouch] : m_pendingBooks)
+    {
+        // The book may have been removed during the transaction
+        if (m_orderbooks[index])
+        {
+            m_dataExporter->set_flush_order(firstTouch);
+            m_orderbooks[index]->flush_bbo();
+        }
+    }
+    m_dataExporter->set_flush_order(0);
+    m_pendingBooks.clear();
+}
+
+void OrderBookManager::finish()
+{
+    if (m_inTransaction)
+        end_transaction();
 }
 
 bool OrderBookManager::contains(const Symbol& ob) const noexcept
 {
-    return m_orderbooks.contains(ob);
+    return find_symbol(ob) != m_symbolIndex.end();
+}
+
+std::optional<Order::BookIndex> OrderBookManager::find_book(const Symbol& ob) const noexcept
+{
+    auto it = find_symbol(ob);
+    return it != m_symbolIndex.end() ? std::optional{it->second} : std::nullopt;
 }
 
 bool OrderBookManager::contains(Order::ID order_id) const noexcept
@@ -66,10 +168,82 @@ bool OrderBookManager::contains(Order::ID order_id) const noexcept
 
 const OrderBook& OrderBookManager::operator[](const Symbol& ob) const
 {
-    return m_orderbooks.at(ob);
+    return book(ob);
 }
 
 const Order& OrderBookManager::find_order(Order::ID order_id) const
 {
     return (*m_orderstore)[order_id];
-}
\ No newline at end of file
+}
+
+uint64_t OrderBookManager::order_messages() const noexcept
+{
+    return m_orderMessages;
+}
+
+OrderStore::OrderRef OrderBookManager::lookup(Order::ID order_id)
+{
+    ++m_orderMessages;
+    OrderStore::OrderRef ref = m_orderstore->lookup(order_id);
+    if (!ref)
+        throw std::out_of_range(std::format("Order {} not found", order_id));
+
+    return ref;
+}
+
+template<typename Policy>
+void OrderBookManager::after_mutation(OrderBook& book)
+{
+    if constexpr (Policy::ConflateBBO)
+    {
+        if (!book.bbo_pending())
+            return;
+
+        if (!m_inTransaction)
+            book.flush_bbo();
+        else if (std::ranges::find(m_pendingBooks, book.get_index(), &std::pair<Order::BookIndex, uint64_t>::first) == m_pendingBooks.end())
+            m_pendingBooks.push_back({book.get_index(), m_dataExporter->message_seq_num()}); // Transactions touch a handful of books: linear search
+    }
+}
+
+OrderBook& OrderBookManager::book(const Symbol& symbol) const
+{
+    auto it = find_symbol(symbol);
+    if (it == m_symbolIndex.end())
+        throw std::out_of_range("No order book for this symbol");
+
+    return *m_orderbooks[it->second];
+}
+
+OrderBook& OrderBookManager::book(Order::BookIndex index) const
+{
+    if (index >= m_orderbooks.size() || !m_orderbooks[index])
+        throw std::out_of_range(std::format("No order book {}", index));
+
+    return *m_orderbooks[index];
+}
+
+std::vector<std::pair<uint64_t, Order::BookIndex>>::const_iterator OrderBookManager::find_symbol(const Symbol& symbol) const noexcept
+{
+    uint64_t key = symbol.key();
+    auto it = std::ranges::lower_bound(m_symbolIndex, key, {}, &std::pair<uint64_t, Order::BookIndex>::first);
+
+    return it != m_symbolIndex.end() && it->first == key ? it : m_symbolIndex.end();
+}
+
+// Every policy the parser can select (see with_book_policy)
+#define INSTANTIATE_OBM_MUTATIONS(...) \
+    template void OrderBookManager::add_order<__VA_ARGS__>(Order::ID, const Symbol&, Order::Price, Order::Quantity, Order::Side); \
+    template void OrderBookManager::add_order<__VA_ARGS__>(Order::ID, Order::BookIndex, Order::Price, Order::Quantity, Order::Side); \
+    template void OrderBookManager::cancel_order<__VA_ARGS__>(Order::ID); \
+    template void OrderBookManager::modify_order<__VA_ARGS__>(Order::ID, Order::Price, Order::Quantity); \
+    template void OrderBookManager::reduce_order<__VA_ARGS__>(Order::ID, Order::Quantity); \
+    template void OrderBookManager::execute_order<__VA_ARGS__>(Order::ID, Order::Quantity);
+
+INSTANTIATE_OBM_MUTATIONS(BookPolicy<true, true, false>)
+INSTANTIATE_OBM_MUTATIONS(BookPolicy<true, false, false>)
+INSTANTIATE_OBM_MUTATIONS(BookPolicy<false, true, false>)
+INSTANTIATE_OBM_MUTATIONS(BookPolicy<false, false, false>)
+INSTANTIATE_OBM_MUTATIONS(BookPolicy<true, true, true>)
+INSTANTIATE_OBM_MUTATIONS(BookPolicy<true, false, true>)
+#undef INSTANTIATE_OBM_MUTATIONS
@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <bit>
+#include <utility>
+
+#include "OrderRouter.hpp"
+
+namespace
+{
+    constexpr std::size_t MaxLoadNumerator = 7; // Grow the index past 7/8 occupancy
+    constexpr std::size_t MaxLoadDenominator = 8;
+    constexpr std::size_t MinSlots = 1024;
+}
+
+OrderRouter::OrderRouter()
+    : m_slots{}, m_shift{64}, m_size{0}
+{
+    rehash(MinSlots);
+}
+
+void OrderRouter::reserve(std::size_t capacity)
+{
+    std::size_t slotCount = std::bit_ceil(capacity * MaxLoadDenominator / MaxLoadNumerator + 1);
+    if (slotCount > m_slots.size())
+        rehash(slotCount);
+}
+
+void OrderRouter::add(Order::ID id, uint8_t shard, Order::Quantity quantity)
+{
+    if (std::size_t i = find_slot(id); i != npos)
+    {
+        m_slots[i].shard = shard;
+        m_slots[i].quantity = quantity;
+        return;
+    }
+
+    if ((m_size + 1) * MaxLoadDenominator > m_slots.size() * MaxLoadNumerator)
+        rehash(m_slots.size() * 2);
+    insert_slot(bucket(id), {id, quantity, 1, shard});
+    ++m_size;
+}
+
+uint8_t OrderRouter::erase(Order::ID id)
+{
+    std::size_t i = find_slot(id);
+    if (i == npos)
+        return NoShard;
+
+    uint8_t shard = m_slots[i].shard;
+    erase_slot(i);
+    return shard;
+}
+
+uint8_t OrderRouter::modify(Order::ID id, Order::Quantity quantity)
+{
+    std::size_t i = find_slot(id);
+    if (i == npos)
+        return NoShard;
+
+    m_slots[i].quantity = quantity;
+    return m_slots[i].shard;
+}
+
+uint8_t OrderRouter::reduce(Order::ID id, Order::Quantity quantity)
+{
+    std::size_t i = find_slot(id);
+    if (i == npos)
+        return NoShard;
+
+    m_slots[i].quantity -= quantity;
+    return m_slots[i].shard;
+}
+
+uint8_t OrderRouter::execute(Order::ID id, Order::Quantity quantity)
+{
+    std::size_t i = find_slot(id);
+    if (i == npos)
+        return NoShard;
+
+    uint8_t shard = m_slots[i].shard;
+    if (m_slots[i].quantity == quantity)
+        erase_slot(i);
+    else
+        m_slots[i].quantity -= quantity;
+    return shard;
+}
+
+std::size_t OrderRouter::size() const noexcept
+{
+    return m_size;
+}
+
+std::size_t OrderRouter::bucket(Order::ID id) const noexcept
+{
+    // Fibonacci hashing, as in OrderStore
+    return static_cast<std::size_t>((id * 0x9E3779B97F4A7C15ull) >> m_shift);
+}
+
+std::size_t OrderRouter::find_slot(Order::ID id) const noexcept
+{
+    const std::size_t mask = m_slots.size() - 1;
+    std::size_t i = bucket(id);
+    for (uint16_t distance = 1; ; ++distance, i = (i + 1) & mask)
+    {
+        const Slot_& slot = m_slots[i];
+        if (slot.distance < distance)
+            return npos;
+        if (slot.id == id)
+            return i;
+    }
+}
+
+void OrderRouter::insert_slot(std::size_t i, Slot_ slot) noexcept
+{
+    const std::size_t mask = m_slots.size() - 1;
+    for (;; i = (i + 1) & mask, ++slot.distance)
+    {
+        if (m_slots[i].distance == 0)
+        {
+            m_slots[i] = slot;
+            return;
+        }
+        if (m_slots[i].distance < slot.distance)
+            std::swap(m_slots[i], slot);
+    }
+}
+
+void OrderRouter::erase_slot(std::size_t i) noexcept
+{
+    --m_size;
+
+    // Backward shift deletion, as in OrderStore
+    const std::size_t mask = m_slots.size() - 1;
+    std::size_t next = (i + 1) & mask;
+    while (m_slots[next].distance > 1)
+    {
+        m_slots[i] = m_slots[next];
+        --m_slots[i].distance;
+        i = next;
+        next = (next + 1) & mask;
+    }
+    m_slots[i] = Slot_{};
+}
+
+void OrderRouter::rehash(std::size_t slotCount)
+{
+    slotCount = std::max(slotCount, MinSlots);
+    std::vector<Slot_> old = std::exchange(m_slots, std::vector<Slot_>(slotCount));
+    m_shift = 64 - std::countr_zero(slotCount);
+
+    for (const Slot_& slot : old)
+    {
+        if (slot.distance != 0)
+            insert_slot(bucket(slot.id), {slot.id, slot.quantity, 1, slot.shard});
+    }
+}
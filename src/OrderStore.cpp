@@ -1,29 +1,269 @@
+#include <algorithm>
+#include <bit>
+#include <format>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
 #include "OrderStore.hpp"
+#include "PriceLevel.hpp"
+
+// Slots are reused without running destructors
+static_assert(std::is_trivially_destructible_v<Order>, "Order must be trivially destructible");
+
+namespace
+{
+    constexpr std::size_t npos = static_cast<std::size_t>(-1);
+    constexpr std::size_t MaxLoadNumerator = 7; // Grow the index past 7/8 occupancy
+    constexpr std::size_t MaxLoadDenominator = 8;
+    constexpr std::size_t MinSlots = 1024;
+}
 
-Order* OrderStore::add_order(Order::ID id, const Symbol& symbol, Order::Price price, Order::Quantity quantity, Order::Side side)
+void OrderStore::reserve(std::size_t capacity)
 {
-    // Construct order in-place by forwarding key and arguments for Order constructor
-    m_orders.try_emplace(id, id, symbol, price, quantity, side);
+    std::size_t slotCount = std::bit_ceil(capacity * MaxLoadDenominator / MaxLoadNumerator + 1);
+    if (slotCount > m_slots.size())
+        rehash(slotCount);
 
-    return &m_orders.at(id);
+    while (m_chunks.size() * ChunkSize < capacity)
+    {
+        m_chunks.push_back(std::make_unique<Storage_[]>(ChunkSize));
+        m_coldChunks.push_back(std::make_unique<ColdOrder[]>(ChunkSize));
+    }
+    m_free.reserve(capacity);
+}
+
+Order* OrderStore::add_order(Order::ID id, Order::BookIndex book, Order::Quantity quantity)
+{
+    // Same semantics as try_emplace: an existing order is returned untouched
+    return try_add_order(id, book, quantity).first;
+}
+
+std::pair<Order*, bool> OrderStore::try_add_order(Order::ID id, Order::BookIndex book, Order::Quantity quantity)
+{
+    if ((m_size + 1) * MaxLoadDenominator > m_slots.size() * MaxLoadNumerator)
+        rehash(m_slots.size() * 2);
+
+    ++m_probes;
+    const std::size_t mask = m_slots.size() - 1;
+    std::size_t i = bucket(id);
+    uint32_t distance = 1;
+    for (;; ++distance, i = (i + 1) & mask)
+    {
+        const Slot_& slot = m_slots[i];
+        if (slot.distance < distance)
+            break; // Absent: the id belongs here
+        if (slot.id == id)
+            return {&get(slot.handle), false};
+    }
+
+    Handle handle = allocate();
+    Order* order = new (m_chunks[handle >> ChunkShift][handle & (ChunkSize - 1)].bytes) Order(handle, book, quantity);
+    m_coldChunks[handle >> ChunkShift][handle & (ChunkSize - 1)] = {id, quantity, quantity};
+    insert_slot(i, {id, handle, distance});
+    ++m_size;
+
+    return {order, true};
 }
 
 Order& OrderStore::operator[] (Order::ID order_id)
 {
-    return m_orders.at(order_id);
+    Handle handle = find(order_id);
+    if (handle == InvalidHandle)
+        throw std::out_of_range(std::format("Order {} not found", order_id));
+
+    return get(handle);
 }
 
 void OrderStore::erase(Order::ID order_id)
 {
-    m_orders.erase(order_id);
+    if (OrderRef ref = lookup(order_id))
+        erase(ref);
+}
+
+void OrderStore::erase(const OrderRef& ref)
+{
+    std::size_t i = ref.slot;
+    m_free.push_back(m_slots[i].handle);
+    --m_size;
+
+    // Backward shift deletion: pull the following displaced entries one bucket closer to home
+    const std::size_t mask = m_slots.size() - 1;
+    std::size_t next = (i + 1) & mask;
+    while (m_slots[next].distance > 1)
+    {
+        m_slots[i] = m_slots[next];
+        --m_slots[i].distance;
+        i = next;
+        next = (next + 1) & mask;
+    }
+    m_slots[i] = Slot_{};
 }
 
 const Order& OrderStore::operator[] (Order::ID order_id) const
 {
-    return m_orders.at(order_id);
+    Handle handle = find(order_id);
+    if (handle == InvalidHandle)
+        throw std::out_of_range(std::format("Order {} not found", order_id));
+
+    return get(handle);
 }
 
 bool OrderStore::contains(Order::ID order_id) const noexcept
 {
-    return m_orders.contains(order_id);
-}
\ No newline at end of file
+    return find(order_id) != InvalidHandle;
+}
+
+OrderStore::OrderRef OrderStore::lookup(Order::ID order_id) noexcept
+{
+    std::size_t i = find_slot(order_id);
+    if (i == npos)
+        return {};
+
+    return {&get(m_slots[i].handle), i};
+}
+
+OrderStore::Handle OrderStore::find(Order::ID order_id) const noexcept
+{
+    std::size_t i = find_slot(order_id);
+    return i == npos ? InvalidHandle : m_slots[i].handle;
+}
+
+Order& OrderStore::get(Handle handle) noexcept
+{
+    return *std::launder(reinterpret_cast<Order*>(m_chunks[handle >> ChunkShift][handle & (ChunkSize - 1)].bytes));
+}
+
+const Order& OrderStore::get(Handle handle) const noexcept
+{
+    return *std::launder(reinterpret_cast<const Order*>(m_chunks[handle >> ChunkShift][handle & (ChunkSize - 1)].bytes));
+}
+
+OrderStore::ColdOrder& OrderStore::cold(const Order& order) noexcept
+{
+    Handle handle = order.get_handle();
+    return m_coldChunks[handle >> ChunkShift][handle & (ChunkSize - 1)];
+}
+
+const OrderStore::ColdOrder& OrderStore::cold(const Order& order) const noexcept
+{
+    Handle handle = order.get_handle();
+    return m_coldChunks[handle >> ChunkShift][handle & (ChunkSize - 1)];
+}
+
+void OrderStore::print_info(const Order& order) const
+{
+    const ColdOrder& info = cold(order);
+    std::string side = order.get_side() == Order::Side::Buy ? "Buy" : "Sell";
+    std::string type = "Limit Order";
+
+    std::cout << std::format(
+        "-- LimitOrder Information --\n"
+        "{:<20} {}\n"  // Align left in 20 spaces
+        "{:<20} {}\n"
+        "{:<20} {}\n"
+        "{:<20} {}\n"
+        "{:<20} {}\n"
+        "{:<20} {}\n"
+        "{:<20} {}\n",
+        "ID:", info.id, 
+        "Book:", order.get_book(),
+        "Type:", type,                                           
+        "Side:", side,                      
+        "Price:", order.get_price(),                   
+        "Initial Quantity:", info.initialQty,        
+        "Remaining Quantity:", order.get_remaining_quantity()) << std::endl;     
+}
+
+std::size_t OrderStore::size() const noexcept
+{
+    return m_size;
+}
+
+std::size_t OrderStore::capacity() const noexcept
+{
+    return m_nextHandle;
+}
+
+uint64_t OrderStore::probes() const noexcept
+{
+    return m_probes;
+}
+
+OrderStore::Handle OrderStore::allocate()
+{
+    if (!m_free.empty())
+    {
+        Handle handle = m_free.back();
+        m_free.pop_back();
+        return handle;
+    }
+
+    if (m_nextHandle == InvalidHandle)
+        throw std::length_error("OrderStore: too many live orders");
+
+    Handle handle = m_nextHandle++;
+    if ((handle >> ChunkShift) == m_chunks.size())
+    {
+        m_chunks.push_back(std::make_unique<Storage_[]>(ChunkSize));
+        m_coldChunks.push_back(std::make_unique<ColdOrder[]>(ChunkSize));
+    }
+
+    return handle;
+}
+
+std::size_t OrderStore::bucket(Order::ID order_id) const noexcept
+{
+    // Fibonacci hashing: order ids are sequential-ish, the multiplication spreads them over the top bits
+    return static_cast<std::size_t>((order_id * 0x9E3779B97F4A7C15ull) >> m_shift);
+}
+
+std::size_t OrderStore::find_slot(Order::ID order_id) const noexcept
+{
+    ++m_probes;
+    if (m_size == 0)
+        return npos;
+
+    const std::size_t mask = m_slots.size() - 1;
+    std::size_t i = bucket(order_id);
+    for (uint32_t distance = 1; ; ++distance, i = (i + 1) & mask)
+    {
+        const Slot_& slot = m_slots[i];
+        // Robin Hood invariant: the id would have displaced any entry closer to its home bucket
+        if (slot.distance < distance)
+            return npos;
+        if (slot.id == order_id)
+            return i;
+    }
+}
+
+// Places slot at bucket i (distance from its home bucket already counted), displacing richer entries
+void OrderStore::insert_slot(std::size_t i, Slot_ slot) noexcept
+{
+    const std::size_t mask = m_slots.size() - 1;
+    for (;; i = (i + 1) & mask, ++slot.distance)
+    {
+        if (m_slots[i].distance == 0)
+        {
+            m_slots[i] = slot;
+            return;
+        }
+        if (m_slots[i].distance < slot.distance)
+            std::swap(m_slots[i], slot); // Take from the rich: continue inserting the displaced entry
+    }
+}
+
+void OrderStore::rehash(std::size_t slotCount)
+{
+    slotCount = std::max(slotCount, MinSlots);
+    std::vector<Slot_> old = std::exchange(m_slots, std::vector<Slot_>(slotCount));
+    m_shift = 64 - std::countr_zero(slotCount);
+
+    for (const Slot_& slot : old)
+    {
+        if (slot.distance != 0)
+            insert_slot(bucket(slot.id), {slot.id, slot.handle, 1});
+    }
+}
@@ -0,0 +1,328 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include "PacketIndex.hpp"
+#include "cfepitch.h"
+
+namespace
+{
+    constexpr char IndexMagic[8] = {'M', 'B', 'O', 'P', 'I', 'D', 'X', '\0'};
+
+    struct IndexFileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t interval;
+        uint64_t sourceSize;
+        int64_t sourceMtime;
+        uint64_t dayCount;
+        uint64_t entryCount;
+    };
+    static_assert(sizeof(IndexFileHeader) == 48, "IndexFileHeader must be 48 bytes");
+
+    struct IndexFileDay
+    {
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    int64_t source_mtime(const std::string& pcapFile)
+    {
+        auto mtime = std::filesystem::last_write_time(pcapFile);
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(mtime.time_since_epoch()).count();
+    }
+}
+
+PacketIndex::PacketIndex(const std::string& pcapFile, uint32_t interval)
+    : m_pcapFilename{pcapFile}, m_interval{interval}, m_sourceSize{std::filesystem::file_size(pcapFile)},
+      m_sourceMtime{source_mtime(pcapFile)}, m_days{}, m_entries{}
+{
+}
+
+std::string PacketIndex::index_filename(const std::string& pcapFile)
+{
+    return pcapFile + ".idx";
+}
+
+PacketIndex PacketIndex::load_or_build(const std::string& pcapFile, uint32_t interval)
+{
+    if (auto index = load(pcapFile); index && index->m_interval == interval)
+    {
+        return std::move(*index);
+    }
+
+    PacketIndex index = build(pcapFile, interval);
+    try
+    {
+        index.save();
+    }
+    catch (const std::ios_base::failure& e)
+    {
+        // The index is only a cache: a read-only capture directory must not prevent parsing
+        std::cerr << "Warning: " << e.what() << '\n';
+    }
+    return index;
+}
+
+PacketIndex PacketIndex::build(const std::string& pcapFile, uint32_t interval)
+{
+    PacketIndex index(pcapFile, interval);
+    MmapPcapReader reader(pcapFile);
+    PcapRecord record;
+
+    constexpr std::size_t headerOffset = 42;
+    uint32_t nextExpectedSeqNum = 1;
+    uint64_t sequencedPackets = 0;
+    uint32_t day = 0;
+    std::size_t dayBegin = MmapPcapReader::FileHeaderSize;
+
+    // Feed state carried from one entry to the next
+    uint32_t time = 0;
+    uint32_t midnightReference = 0;
+    uint32_t tradeDate = 0;
+    std::optional<std::size_t> pendingDayStart;
+
+    while (reader.next(record))
+    {
+        if (record.caplen < headerOffset + sizeof(SequencedUnitHeader))
+            continue;
+
+        SequencedUnitHeader suHeader;
+        std::memcpy(&suHeader, record.data + headerOffset, sizeof(SequencedUnitHeader));
+
+        if (suHeader.HdrUnit != 1 || suHeader.HdrSequence == 0 || suHeader.HdrCount == 0)
+            continue;
+
+        // Same day boundaries as PcapSlicer::daily_scan()
+        bool newDay = suHeader.HdrSequence < nextExpectedSeqNum;
+        if (newDay)
+        {
+            index.m_days.push_back({dayBegin, record.offset});
+            dayBegin = record.offset;
+            ++day;
+        }
+
+        // The first packet of every day is always indexed so days can be located directly
+        bool dayStart = newDay || sequencedPackets == 0;
+        if (dayStart || sequencedPackets % interval == 0)
+        {
+            index.m_entries.push_back({record.offset, record.timestamp, suHeader.HdrSequence, day,
+                                       time, midnightReference, tradeDate, 0});
+        }
+        if (dayStart)
+        {
+            // The clock carried over is the previous day's: the entry takes the new day's first TimeReference instead,
+            // which keeps entries sorted by exchange time across day boundaries
+            pendingDayStart = index.m_entries.size() - 1;
+        }
+        ++sequencedPackets;
+        nextExpectedSeqNum = suHeader.HdrSequence + suHeader.HdrCount;
+
+        // Only Time and TimeReference are decoded, every other message is skipped by length
+        std::size_t offset = headerOffset + sizeof(SequencedUnitHeader);
+        for (int j = 0; j < suHeader.HdrCount && offset + sizeof(MessageHeader) <= record.caplen; ++j)
+        {
+            MessageHeader msgHeader;
+            std::memcpy(&msgHeader, record.data + offset, sizeof(MessageHeader));
+            if (msgHeader.MsgLen < sizeof(MessageHeader) || offset + msgHeader.MsgLen > record.caplen)
+                break;
+
+            const u_char* message = record.data + offset + sizeof(MessageHeader);
+            if (msgHeader.MsgType == 0x20 && msgHeader.MsgLen >= sizeof(MessageHeader) + sizeof(Time))
+            {
+                Time m;
+                std::memcpy(&m, message, sizeof(m));
+                time = m.Time;
+            }
+            else if (msgHeader.MsgType == 0xB1 && msgHeader.MsgLen >= sizeof(MessageHeader) + sizeof(TimeReference))
+            {
+                TimeReference m;
+                std::memcpy(&m, message, sizeof(m));
+                midnightReference = m.MidnightReference;
+                tradeDate = m.TradeDate;
+                time = m.Time;
+
+                if (pendingDayStart)
+                {
+                    Entry& entry = index.m_entries[*pendingDayStart];
+                    entry.time = time;
+                    entry.midnightReference = midnightReference;
+                    entry.tradeDate = tradeDate;
+                    pendingDayStart.reset();
+                }
+            }
+            offset += msgHeader.MsgLen;
+        }
+    }
+
+    if (reader.offset() > dayBegin)
+    {
+        index.m_days.push_back({dayBegin, reader.offset()});
+    }
+
+    return index;
+}
+
+std::optional<PacketIndex> PacketIndex::load(const std::string& pcapFile)
+{
+    std::string filename = index_filename(pcapFile);
+    std::ifstream infile(filename, std::ios::in | std::ios::binary);
+    if (!infile.is_open())
+        return std::nullopt;
+
+    IndexFileHeader header;
+    if (!infile.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || std::memcmp(header.magic, IndexMagic, sizeof(IndexMagic)) != 0
+        || header.version != Version)
+    {
+        return std::nullopt;
+    }
+
+    // Counts are checked against the file before anything is allocated from them: a truncated or corrupt
+    // index is as stale as an outdated one
+    std::error_code ec;
+    uint64_t fileSize = std::filesystem::file_size(filename, ec);
+    if (ec || fileSize < sizeof(header))
+        return std::nullopt;
+    uint64_t bodySize = fileSize - sizeof(header);
+    if (header.dayCount > bodySize / sizeof(IndexFileDay))
+        return std::nullopt;
+    uint64_t entriesSize = bodySize - header.dayCount * sizeof(IndexFileDay);
+    if (entriesSize % sizeof(Entry) != 0 || header.entryCount != entriesSize / sizeof(Entry))
+        return std::nullopt;
+
+    PacketIndex index(pcapFile, header.interval);
+    if (index.m_sourceSize != header.sourceSize || index.m_sourceMtime != header.sourceMtime)
+        return std::nullopt; // Stale: the capture was modified after indexing
+
+    std::vector<IndexFileDay> days(header.dayCount);
+    index.m_entries.resize(header.entryCount);
+    if (!infile.read(reinterpret_cast<char*>(days.data()), days.size() * sizeof(IndexFileDay))
+        || !infile.read(reinterpret_cast<char*>(index.m_entries.data()), index.m_entries.size() * sizeof(Entry)))
+    {
+        return std::nullopt;
+    }
+
+    index.m_days.reserve(days.size());
+    for (const auto& [begin, end] : days)
+    {
+        index.m_days.push_back({begin, end});
+    }
+
+    return index;
+}
+
+void PacketIndex::save() const
+{
+    std::string output_filename = index_filename(m_pcapFilename);
+    std::ofstream outfile(output_filename, std::ios::out | std::ios::binary | std::ios::trunc);
+
+    if (!outfile.is_open())
+    {
+        throw std::ios_base::failure("Failed to open file: " + output_filename);
+    }
+
+    IndexFileHeader header{};
+    std::memcpy(header.magic, IndexMagic, sizeof(IndexMagic));
+    header.version = Version;
+    header.interval = m_interval;
+    header.sourceSize = m_sourceSize;
+    header.sourceMtime = m_sourceMtime;
+    header.dayCount = m_days.size();
+    header.entryCount = m_entries.size();
+
+    outfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const auto& day : m_days)
+    {
+        IndexFileDay d{day.begin, day.end};
+        outfile.write(reinterpret_cast<const char*>(&d), sizeof(d));
+    }
+    outfile.write(reinterpret_cast<const char*>(m_entries.data()), m_entries.size() * sizeof(Entry));
+
+    if (!outfile)
+    {
+        throw std::ios_base::failure("Failed to write file: " + output_filename);
+    }
+}
+
+const std::vector<DayRange>& PacketIndex::days() const noexcept
+{
+    return m_days;
+}
+
+const std::vector<PacketIndex::Entry>& PacketIndex::entries() const noexcept
+{
+    return m_entries;
+}
+
+uint64_t PacketIndex::exchange_seconds(const Entry& entry) noexcept
+{
+    // Same convention as DataExporter: the date is the UTC date of the midnight reference
+    return uint64_t{entry.midnightReference} / 86400 * 86400 + entry.time;
+}
+
+uint64_t PacketIndex::parse_exchange_time(const std::string& date, const std::string& time)
+{
+    int year, month, dayOfMonth, hours, minutes, seconds;
+    if (std::sscanf(date.c_str(), "%4d-%2d-%2d", &year, &month, &dayOfMonth) != 3
+        || std::sscanf(time.c_str(), "%2d:%2d:%2d", &hours, &minutes, &seconds) != 3)
+    {
+        throw std::invalid_argument("Invalid date/time: expected YYYY-MM-DD and HH:MM:SS, got " + date + " " + time);
+    }
+
+    std::chrono::year_month_day ymd{std::chrono::year{year}, std::chrono::month{static_cast<unsigned>(month)},
+                                    std::chrono::day{static_cast<unsigned>(dayOfMonth)}};
+    auto midnight = std::chrono::sys_days{ymd}.time_since_epoch();
+
+    return std::chrono::duration_cast<std::chrono::seconds>(midnight).count() + hours * 3600 + minutes * 60 + seconds;
+}
+
+const PacketIndex::Entry* PacketIndex::seek_pcap_time(uint64_t pcapTime) const noexcept
+{
+    auto it = std::upper_bound(m_entries.begin(), m_entries.end(), pcapTime,
+        [](uint64_t t, const Entry& e) { return t < e.pcapTime; });
+
+    return it == m_entries.begin() ? nullptr : &*std::prev(it);
+}
+
+const PacketIndex::Entry* PacketIndex::seek_exchange_time(uint64_t exchangeSeconds) const noexcept
+{
+    auto it = std::upper_bound(m_entries.begin(), m_entries.end(), exchangeSeconds,
+        [](uint64_t t, const Entry& e) { return t < exchange_seconds(e); });
+
+    return it == m_entries.begin() ? nullptr : &*std::prev(it);
+}
+
+const PacketIndex::Entry* PacketIndex::seek_sequence(std::size_t day, uint32_t sequence) const noexcept
+{
+    // Entries are ordered by (day, sequence)
+    auto it = std::upper_bound(m_entries.begin(), m_entries.end(), std::pair{day, sequence},
+        [](const std::pair<std::size_t, uint32_t>& key, const Entry& e)
+        { return key.first < e.day || (key.first == e.day && key.second < e.sequence); });
+
+    if (it == m_entries.begin() || std::prev(it)->day != day)
+        return nullptr;
+
+    return &*std::prev(it);
+}
+
+std::optional<DayRange> PacketIndex::replay_range(uint64_t exchangeSeconds) const noexcept
+{
+    const Entry* entry = seek_exchange_time(exchangeSeconds);
+    if (entry == nullptr)
+        return std::nullopt;
+
+    // Books must be rebuilt from the start of the day; parsing can stop at the first indexed
+    // packet of that day whose exchange time is past the requested time
+    const DayRange& day = m_days[entry->day];
+    const Entry* next = entry + 1;
+    std::size_t end = (next != m_entries.data() + m_entries.size() && next->day == entry->day) ? next->offset : day.end;
+
+    return DayRange{day.begin, end};
+}
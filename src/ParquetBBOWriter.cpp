@@ -0,0 +1,224 @@
+#include <initializer_list>
+#include <ios>
+#include <vector>
+
+#include <arrow/api.h>
+#include <arrow/io/file.h>
+#include <parquet/arrow/writer.h>
+#include <parquet/properties.h>
+
+#include "ParquetBBOWriter.hpp"
+
+namespace
+{
+    void check(const arrow::Status& status, const std::string& filename)
+    {
+        if (!status.ok())
+            throw std::ios_base::failure("Failed to write " + filename + ": " + status.ToString());
+    }
+
+    template<typename T>
+    T check(arrow::Result<T> result, const std::string& filename)
+    {
+        check(result.status(), filename);
+        return std::move(result).ValueUnsafe();
+    }
+}
+
+struct ParquetBBOWriter::Impl
+{
+    explicit Impl(std::size_t rowGroupSize)
+        : rowGroupSize{rowGroupSize}, filename{},
+          priceType{arrow::decimal128(18, 2)},
+          symbolType{arrow::dictionary(arrow::int32(), arrow::utf8())},
+          schema{arrow::schema({
+              arrow::field("timestamp", arrow::timestamp(arrow::TimeUnit::NANO, "UTC"), false),
+              arrow::field("utc_offset", arrow::int32(), false),
+              arrow::field("pkt_seq_num", arrow::uint64(), false),
+              arrow::field("msg_seq_num", arrow::uint64(), false),
+              arrow::field("msg_type", arrow::utf8(), false),
+              arrow::field("symbol", symbolType, false),
+              arrow::field("bid_price", priceType, false),
+              arrow::field("bid_quantity", arrow::uint32(), false),
+              arrow::field("ask_price", priceType, false),
+              arrow::field("ask_quantity", arrow::uint32(), false),
+              arrow::field("trading_status", arrow::utf8(), false)})},
+          timestamp{schema->field(0)->type(), arrow::default_memory_pool()}, utcOffset{}, pktSeqNum{}, msgSeqNum{}, msgType{},
+          symbol{}, bidPrice{priceType}, bidQuantity{}, askPrice{priceType}, askQuantity{}, tradingStatus{},
+          names{}, writer{}, rows{0}
+    {
+    }
+
+    void reserve()
+    {
+        auto n = static_cast<int64_t>(rowGroupSize);
+        check(timestamp.Reserve(n), filename);
+        check(utcOffset.Reserve(n), filename);
+        check(pktSeqNum.Reserve(n), filename);
+        check(msgSeqNum.Reserve(n), filename);
+        check(msgType.Reserve(n), filename);
+        check(symbol.Reserve(n), filename);
+        check(bidPrice.Reserve(n), filename);
+        check(bidQuantity.Reserve(n), filename);
+        check(askPrice.Reserve(n), filename);
+        check(askQuantity.Reserve(n), filename);
+        check(tradingStatus.Reserve(n), filename);
+    }
+
+    // Drops what a failed file left in the builders
+    void clear()
+    {
+        for (arrow::ArrayBuilder* builder : std::initializer_list<arrow::ArrayBuilder*>{&timestamp, &utcOffset, &pktSeqNum, &msgSeqNum, &msgType,
+                                                                                        &symbol, &bidPrice, &bidQuantity, &askPrice, &askQuantity, &tradingStatus})
+            builder->Reset();
+        rows = 0;
+    }
+
+    // Writes the buffered records as one row group and empties the builders
+    void write_row_group()
+    {
+        if (rows == 0)
+            return;
+
+        // The dictionary holds every symbol seen so far, a superset of the ones of this row group
+        arrow::StringBuilder dictionary;
+        check(dictionary.AppendValues(names), filename);
+
+        auto indices = check(symbol.Finish(), filename);
+        auto symbols = check(arrow::DictionaryArray::FromArrays(symbolType, indices, check(dictionary.Finish(), filename)), filename);
+
+        std::vector<std::shared_ptr<arrow::Array>> columns{
+            check(timestamp.Finish(), filename), check(utcOffset.Finish(), filename), check(pktSeqNum.Finish(), filename),
+            check(msgSeqNum.Finish(), filename), check(msgType.Finish(), filename), symbols, check(bidPrice.Finish(), filename),
+            check(bidQuantity.Finish(), filename), check(askPrice.Finish(), filename),
+            check(askQuantity.Finish(), filename), check(tradingStatus.Finish(), filename)};
+
+        auto table = arrow::Table::Make(schema, std::move(columns), rows);
+        check(writer->WriteTable(*table, rows), filename);
+        rows = 0;
+        reserve();
+    }
+
+    std::size_t rowGroupSize;
+    std::string filename;
+    std::shared_ptr<arrow::DataType> priceType;
+    std::shared_ptr<arrow::DataType> symbolType;
+    std::shared_ptr<arrow::Schema> schema;
+    arrow::TimestampBuilder timestamp;
+    arrow::Int32Builder utcOffset;
+    arrow::UInt64Builder pktSeqNum;
+    arrow::UInt64Builder msgSeqNum;
+    arrow::StringBuilder msgType;
+    arrow::Int32Builder symbol;     // Dictionary indices
+    arrow::Decimal128Builder bidPrice;
+    arrow::UInt32Builder bidQuantity;
+    arrow::Decimal128Builder askPrice;
+    arrow::UInt32Builder askQuantity;
+    arrow::StringBuilder tradingStatus;
+    std::vector<std::string> names; // Symbol dictionary
+    std::unique_ptr<parquet::arrow::FileWriter> writer;
+    int64_t rows;                   // Buffered records
+};
+
+ParquetBBOWriter::ParquetBBOWriter(std::size_t rowGroupSize)
+    : m_impl{std::make_unique<Impl>(rowGroupSize)}
+{
+}
+
+ParquetBBOWriter::~ParquetBBOWriter() noexcept
+{
+    try
+    {
+        close();
+    }
+    catch (...)
+    {
+    }
+}
+
+void ParquetBBOWriter::open(const std::string& filename)
+{
+    if (is_open())
+        close();
+
+    m_impl->filename = filename;
+    auto sink = check(arrow::io::FileOutputStream::Open(filename), filename);
+
+    // Sequence numbers and timestamps only grow: delta encoding beats a dictionary on those
+    parquet::WriterProperties::Builder properties;
+    properties.version(parquet::ParquetVersion::PARQUET_2_6)
+        ->compression(parquet::Compression::ZSTD)
+        ->enable_store_decimal_as_integer()
+        ->max_row_group_length(static_cast<int64_t>(m_impl->rowGroupSize));
+    for (const char* column : {"timestamp", "pkt_seq_num", "msg_seq_num"})
+        properties.disable_dictionary(column)->encoding(column, parquet::Encoding::DELTA_BINARY_PACKED);
+
+    // Keep the Arrow schema in the file so readers get the time zone and the dictionary type back
+    auto arrowProperties = parquet::ArrowWriterProperties::Builder().store_schema()->build();
+
+    m_impl->writer = check(parquet::arrow::FileWriter::Open(*m_impl->schema, arrow::default_memory_pool(), sink,
+                                                            properties.build(), arrowProperties), filename);
+    m_impl->clear();
+    m_impl->reserve();
+}
+
+bool ParquetBBOWriter::is_open() const noexcept
+{
+    return m_impl->writer != nullptr;
+}
+
+void ParquetBBOWriter::close()
+{
+    if (!is_open())
+        return;
+
+    // The writer is released whatever happens: a failed file is not written to again
+    try
+    {
+        m_impl->write_row_group();
+        check(m_impl->writer->Close(), m_impl->filename);
+    }
+    catch (...)
+    {
+        m_impl->writer.reset();
+        throw;
+    }
+    m_impl->writer.reset();
+}
+
+void ParquetBBOWriter::add_symbol(std::string_view name)
+{
+    m_impl->names.emplace_back(name);
+}
+
+void ParquetBBOWriter::append(uint64_t timestamp, int32_t utcOffset, uint64_t pktSeqNum, uint64_t msgSeqNum, char msgType, uint32_t symbol,
+                              Order::Price bidPrice, uint32_t bidQuantity, Order::Price askPrice, uint32_t askQuantity, uint8_t tradingStatus)
+{
+    Impl& impl = *m_impl;
+    char status = static_cast<char>(tradingStatus);
+
+    // As in close(): builders left half appended or finished without their reserve are not appended to again
+    try
+    {
+        // Capacity is reserved for a whole row group
+        impl.timestamp.UnsafeAppend(static_cast<int64_t>(timestamp));
+        impl.utcOffset.UnsafeAppend(utcOffset);
+        impl.pktSeqNum.UnsafeAppend(pktSeqNum);
+        impl.msgSeqNum.UnsafeAppend(msgSeqNum);
+        check(impl.msgType.Append(&msgType, 1), impl.filename);
+        impl.symbol.UnsafeAppend(static_cast<int32_t>(symbol));
+        impl.bidPrice.UnsafeAppend(arrow::Decimal128(bidPrice));
+        impl.bidQuantity.UnsafeAppend(bidQuantity);
+        impl.askPrice.UnsafeAppend(arrow::Decimal128(askPrice));
+        impl.askQuantity.UnsafeAppend(askQuantity);
+        check(impl.tradingStatus.Append(&status, 1), impl.filename);
+
+        if (++impl.rows == static_cast<int64_t>(impl.rowGroupSize))
+            impl.write_row_group();
+    }
+    catch (...)
+    {
+        impl.writer.reset();
+        throw;
+    }
+}
@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "PcapReader.hpp"
+
+namespace
+{
+    constexpr uint32_t MagicMicro = 0xa1b2c3d4;
+    constexpr uint32_t MagicNano  = 0xa1b23c4d;
+}
+
+// ---------------- Mapped File ----------------
+
+MappedFile::MappedFile(const std::string& filename)
+    : m_data{nullptr}, m_size{0}
+{
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        throw std::runtime_error("Error: Unable to open the file " + filename);
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) == -1)
+    {
+        ::close(fd);
+        throw std::runtime_error("Error: Unable to stat the file " + filename);
+    }
+    m_size = static_cast<std::size_t>(st.st_size);
+
+    if (m_size > 0)
+    {
+        void* addr = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED)
+        {
+            ::close(fd);
+            throw std::runtime_error("Error: Unable to map the file " + filename);
+        }
+        m_data = static_cast<const u_char*>(addr);
+    }
+    ::close(fd); // The mapping stays valid after the descriptor is closed
+}
+
+MappedFile::~MappedFile() noexcept
+{
+    if (m_data != nullptr)
+    {
+        ::munmap(const_cast<u_char*>(m_data), m_size);
+    }
+}
+
+const u_char* MappedFile::data() const noexcept
+{
+    return m_data;
+}
+
+std::size_t MappedFile::size() const noexcept
+{
+    return m_size;
+}
+
+void MappedFile::advise_sequential(std::size_t begin, std::size_t end) const noexcept
+{
+    if (m_data == nullptr || begin >= end)
+        return;
+
+    // madvise requires a page aligned start address
+    static const std::size_t pageSize = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    std::size_t alignedBegin = begin - (begin % pageSize);
+    void* addr = const_cast<u_char*>(m_data + alignedBegin);
+    std::size_t length = std::min(end, m_size) - alignedBegin;
+
+    ::madvise(addr, length, MADV_SEQUENTIAL);
+    ::madvise(addr, length, MADV_WILLNEED);
+}
+
+// ---------------- Mmap Pcap Reader ----------------
+
+MmapPcapReader::MmapPcapReader(const std::string& filename)
+    : m_file{filename}, m_swapped{false}, m_nanosecond{false}, m_offset{FileHeaderSize}, m_end{m_file.size()}
+{
+    if (m_file.size() < FileHeaderSize)
+    {
+        throw std::runtime_error("Error: " + filename + " is too small to be a pcap file");
+    }
+
+    uint32_t magic;
+    std::memcpy(&magic, m_file.data(), sizeof(magic));
+
+    if (magic == MagicMicro || magic == MagicNano)
+    {
+        m_nanosecond = magic == MagicNano;
+    }
+    else if (__builtin_bswap32(magic) == MagicMicro || __builtin_bswap32(magic) == MagicNano)
+    {
+        m_swapped = true;
+        m_nanosecond = __builtin_bswap32(magic) == MagicNano;
+    }
+    else
+    {
+        throw std::runtime_error("Error: " + filename + " is not a pcap file (unknown magic number)");
+    }
+
+    m_file.advise_sequential(m_offset, m_end);
+}
+
+void MmapPcapReader::set_range(std::size_t begin, std::size_t end)
+{
+    if (begin < FileHeaderSize || begin > end || end > m_file.size())
+    {
+        throw std::out_of_range("Invalid pcap byte range");
+    }
+
+    m_offset = begin;
+    m_end = end;
+    m_file.advise_sequential(m_offset, m_end);
+}
+
+bool MmapPcapReader::next(PcapRecord& record) noexcept
+{
+    if (m_offset + RecordHeaderSize > m_end)
+        return false;
+
+    const u_char* header = m_file.data() + m_offset;
+    uint32_t tsSec  = read_u32(header);
+    uint32_t tsFrac = read_u32(header + 4);
+    uint32_t caplen = read_u32(header + 8);
+
+    // A truncated last record (e.g. capture interrupted) ends the file, like libpcap does
+    if (m_offset + RecordHeaderSize + caplen > m_file.size())
+        return false;
+
+    record.data = header + RecordHeaderSize;
+    record.caplen = caplen;
+    record.len = read_u32(header + 12);
+    record.timestamp = uint64_t{tsSec} * 1'000'000'000 + (m_nanosecond ? tsFrac : uint64_t{tsFrac} * 1'000);
+    record.offset = m_offset;
+
+    m_offset += RecordHeaderSize + caplen;
+    return true;
+}
+
+bool MmapPcapReader::nanosecond() const noexcept
+{
+    return m_nanosecond;
+}
+
+std::size_t MmapPcapReader::offset() const noexcept
+{
+    return m_offset;
+}
+
+std::size_t MmapPcapReader::file_size() const noexcept
+{
+    return m_file.size();
+}
+
+const u_char* MmapPcapReader::file_header() const noexcept
+{
+    return m_file.data();
+}
+
+uint32_t MmapPcapReader::read_u32(const u_char* p) const noexcept
+{
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return m_swapped ? __builtin_bswap32(value) : value;
+}
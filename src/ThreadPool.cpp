@@ -4,71 +4,178 @@
 #include <deque>
 #include <mutex>
 #include <future>
-#include <condition_variable>
 
 #include "ThreadPool.hpp"
 
+namespace
+{
+    // Identifies the worker (if any) running on the current thread
+    thread_local const ThreadPool* t_pool = nullptr;
+    thread_local std::size_t t_workerIndex = 0;
+}
+
 ThreadPool::ThreadPool(size_t numWorkers)
+    : m_workers{}, m_injected{}, m_injectedMtx{}, m_injectedCount{0}, m_pending{0}, m_wakeups{0}, m_stop{false}
 {
+    numWorkers = std::max<size_t>(numWorkers, 1);
+
+    // All deques exist before any worker starts stealing
     m_workers.reserve(numWorkers);
-    for (size_t i = 0; i < numWorkers; ++i) 
+    for (size_t i = 0; i < numWorkers; ++i)
+    {
+        m_workers.push_back(std::make_unique<Worker_>());
+    }
+    for (size_t i = 0; i < numWorkers; ++i)
     {
-        m_workers.emplace_back(this); // Push the the given number of worker threads to the thread pool
+        m_workers[i]->thread = std::jthread(&ThreadPool::worker_loop, this, i);
     }
 }
 
 ThreadPool::~ThreadPool()
 {
-    for (auto& worker : m_workers) 
+    m_stop.store(true, std::memory_order_seq_cst);
+    m_wakeups.fetch_add(1, std::memory_order_release);
+    m_wakeups.notify_all();
+
+    for (auto& worker : m_workers)
     {
-        worker.request_stop(); // Stops all the threads
+        worker->thread.join(); // Workers drain every queue before exiting
     }
 }
 
 void ThreadPool::wait_all_done()
 {
-    std::unique_lock<std::mutex> lock(m_taskQueueMtx);
-    m_allDoneCV.wait(lock, [this] { return m_tasks.empty(); }); // Wait for all workers to empty the task queue
+    std::size_t pending = m_pending.load(std::memory_order_acquire);
+    while (pending != 0)
+    {
+        m_pending.wait(pending, std::memory_order_acquire);
+        pending = m_pending.load(std::memory_order_acquire);
+    }
+}
+
+std::size_t ThreadPool::size() const noexcept
+{
+    return m_workers.size();
 }
 
-ThreadPool::Task ThreadPool::dequeue(std::stop_token& st)
+void ThreadPool::submit(Task* const* tasks, std::size_t count)
 {
-    Task task;
-    std::unique_lock<std::mutex> lock(m_taskQueueMtx);
+    if (count == 0)
+        return;
 
-    // If queue is empty, current thread waits until a new task is added to the queue or until the stop token is triggered
-    // Added a predicate that checks if the queue is indeed empty to prevent spurious wake-ups
-    m_taskQueueCV.wait(lock, st, [this] { return !m_tasks.empty(); });
-    if (!st.stop_requested()) 
+    m_pending.fetch_add(count, std::memory_order_relaxed);
+
+    if (t_pool == this)
     {
-        task = std::move(m_tasks.front());
-        m_tasks.pop();
-        if (m_tasks.empty()) 
+        // Nested submission: lock-free push to the calling worker's own deque
+        auto& deque = m_workers[t_workerIndex]->deque;
+        for (std::size_t i = 0; i < count; ++i)
         {
-            m_allDoneCV.notify_all(); // Notify when all tasks are done
+            deque.push(tasks[i]);
         }
     }
+    else
+    {
+        std::lock_guard lk{ m_injectedMtx };
+        m_injected.insert(m_injected.end(), tasks, tasks + count);
+        m_injectedCount.fetch_add(count, std::memory_order_release);
+    }
 
-    return task;
+    m_wakeups.fetch_add(1, std::memory_order_release);
+    if (count == 1)
+        m_wakeups.notify_one();
+    else
+        m_wakeups.notify_all();
 }
 
-// ---------------- Worker Thread ----------------
+ThreadPool::Task* ThreadPool::find_task(std::size_t self)
+{
+    // 1. Own deque, newest first (cache-warm)
+    if (self < m_workers.size())
+    {
+        if (auto task = m_workers[self]->deque.pop())
+            return *task;
+    }
 
-ThreadPool::Worker_::Worker_(ThreadPool* pool) 
-    : m_pool(pool), m_thread(std::bind_front(&Worker_::run_task, this)) // Binds the current object's member function run_task() to the jthread
-{}
+    // 2. Shared injection queue, oldest first
+    if (m_injectedCount.load(std::memory_order_acquire) != 0)
+    {
+        std::lock_guard lk{ m_injectedMtx };
+        if (!m_injected.empty())
+        {
+            Task* task = m_injected.front();
+            m_injected.pop_front();
+            m_injectedCount.fetch_sub(1, std::memory_order_relaxed);
+            return task;
+        }
+    }
 
-void ThreadPool::Worker_::request_stop()
+    // 3. Steal the oldest task of another worker
+    const std::size_t n = m_workers.size();
+    for (std::size_t i = 1; i <= n; ++i)
+    {
+        std::size_t victim = (self + i) % n;
+        if (victim == self)
+            continue;
+        if (auto task = m_workers[victim]->deque.steal())
+            return *task;
+    }
+
+    return nullptr;
+}
+
+bool ThreadPool::try_run_one()
 {
-    m_thread.request_stop(); // Signal thread to stop
+    std::size_t self = t_pool == this ? t_workerIndex : m_workers.size();
+    Task* task = find_task(self);
+    if (task == nullptr)
+        return false;
+
+    run(task);
+    return true;
 }
 
-void ThreadPool::Worker_::run_task(std::stop_token st)
+void ThreadPool::run(Task* task)
 {
-    while (auto task = m_pool->dequeue(st)) 
+    (*task)(); // packaged_task stores any exception in the future
+    delete task;
+
+    if (m_pending.fetch_sub(1, std::memory_order_seq_cst) == 1)
     {
-        task(); // Execute the task
+        m_pending.notify_all(); // Completion barrier reached
+
+        // Workers idling during shutdown only exit once nothing is pending
+        if (m_stop.load(std::memory_order_seq_cst))
+        {
+            m_wakeups.fetch_add(1, std::memory_order_release);
+            m_wakeups.notify_all();
+        }
     }
 }
 
+// ---------------- Worker Thread ----------------
+
+void ThreadPool::worker_loop(std::size_t self)
+{
+    t_pool = this;
+    t_workerIndex = self;
+
+    while (true)
+    {
+        // Read the wake-up counter before looking for work so a submission made in between is never missed
+        uint64_t wakeups = m_wakeups.load(std::memory_order_acquire);
 
+        if (Task* task = find_task(self))
+        {
+            run(task);
+            continue;
+        }
+
+        if (m_stop.load(std::memory_order_seq_cst) && m_pending.load(std::memory_order_seq_cst) == 0)
+            break;
+
+        m_wakeups.wait(wakeups, std::memory_order_acquire);
+    }
+
+    t_pool = nullptr;
+}
@@ -5,15 +5,19 @@
 #include <sstream>
 #include <filesystem>
 #include <cstdlib>  
+#include <future>
 #include <thread>
 
+#include "BBOFile.hpp"
 #include "CBOEPcapParser.hpp"
 #include "Config.hpp"
 #include "cxxopts.hpp"
 #include "OrderBook.hpp"
 #include "OrderBookManager.hpp"
 #include "OrderStore.hpp"
+#include "PacketIndex.hpp"
 #include "StopWatch.hpp"
+#include "ThreadPool.hpp"
 
 void init(std::size_t day)
 {
@@ -21,6 +25,12 @@ void init(std::size_t day)
     CBOEPcapParser pcap_parser(input_filename, day);
     pcap_parser.start();
 }
+
+void init_range(const std::string& input_filename, std::size_t day, DayRange range)
+{
+    CBOEPcapParser pcap_parser(input_filename, day, range);
+    pcap_parser.start();
+}
    
 int main(int argc, char* argv[])
 {
@@ -33,6 +43,16 @@ int main(int argc, char* argv[])
     {   
         auto& config = Config::getInstance();
 
+        if (config.dumpBBO())
+        {
+            for (const auto& input : config.getInputFiles())
+            {
+                BBOReader reader(input);
+                reader.write_csv(std::cout);
+            }
+            return 0;
+        }
+
         StopWatch sw;
         if (config.time())
         {
@@ -40,6 +60,35 @@ int main(int argc, char* argv[])
             sw.Start();
         }
 
+        // The stage threads, event logs and sidecar index of a day keep to the multi-pass flow below
+        bool singlePass = config.singlePass() && !config.gaps_or_msgSum_excl() && !config.pipeline() && config.shards() == 1 &&
+                          !config.eventLog() && !config.index();
+        if (singlePass)
+        {
+            // Gaps, message summary, days and books all come from one read of each input, a failing input
+            // stops its own days only
+            std::size_t dayCount = 0;
+            for (const auto& input : config.getInputFiles())
+            {
+                try
+                {
+                    CBOEPcapParser parser{input, 0};
+                    dayCount += parser.single_pass(dayCount + 1);
+                }
+                catch (const std::exception& e)
+                {
+                    std::cerr << "ERROR: " << input << ": " << e.what() << '\n';
+                }
+            }
+
+            if (config.time())
+            {
+                sw.Stop();
+                sw.display_time();
+            }
+            return 0;
+        }
+
         StopWatch swGapsSmry;
         if (config.msgSummary() || config.gaps())
         {
@@ -48,8 +97,11 @@ int main(int argc, char* argv[])
                 swGapsSmry.set_name("Gaps and/or Message Summary Time");
                 swGapsSmry.Start();
             }
-            CBOEPcapParser parser{config.getInputFile(), 0};
-            parser.messages_summary();
+            for (const auto& input : config.getInputFiles())
+            {
+                CBOEPcapParser parser{input, 0};
+                parser.messages_summary();
+            }
 
             swGapsSmry.Stop();
             if (config.gaps_or_msgSum_excl())
@@ -59,34 +111,69 @@ int main(int argc, char* argv[])
             }
         }
 
+        std::size_t numThreads = config.threads() ? config.threads() : std::max(1u, std::thread::hardware_concurrency());
+        ThreadPool pool(numThreads);
+        std::vector<std::future<void>> days{};
+
+        // Days are submitted as soon as their input file is split, so parsing overlaps the slicing of the next file
         StopWatch swSlice;
+        if (config.time())
         {
-            if (config.time())
+            swSlice.set_name("Slicing Time");
+        }
+
+        for (const auto& input : config.getInputFiles())
+        {
+            swSlice.Start();
+
+            PcapSlicer slicer(input);
+            std::vector<DayRange> ranges{};
+            if (config.index())
             {
-                swSlice.set_name("Slicing Time");
-                swSlice.Start();
+                // Day ranges come straight from the sidecar index when it is up to date
+                PacketIndex index = PacketIndex::load_or_build(input);
+                ranges = index.days();
+
+                if (config.showOB())
+                {
+                    // Only the day holding the requested time needs to be replayed, and only up to that time
+                    const auto& args = config.orderbook();
+                    auto range = index.replay_range(PacketIndex::parse_exchange_time(args[1], args[2]));
+                    ranges = range ? std::vector<DayRange>{*range} : std::vector<DayRange>{};
+                }
+            }
+            else if (config.scan() || config.eventLog())
+            {
+                ranges = slicer.daily_scan(); // Header-only pass, days are parsed in place (event logs are keyed by range)
+            }
+            else
+            {
+                std::size_t firstDay = days.size() + 1;
+                std::size_t dayCount = slicer.daily_slice(firstDay);
+                for (std::size_t day = firstDay; day < firstDay + dayCount; ++day)
+                {
+                    days.push_back(pool.enqueue(init, day));
+                }
             }
 
-            PcapSlicer slicer(config.getInputFile());
-            slicer.daily_slice();
+            for (const auto& range : ranges)
+            {
+                days.push_back(pool.enqueue(init_range, input, days.size() + 1, range));
+            }
 
             swSlice.Stop();
         }
 
+        // Collect every day: a failing day is reported without stopping the others
+        for (std::size_t i = 0; i < days.size(); ++i)
         {
-            std::vector<std::thread> threads{};
-
-            for (std::size_t i = 1; i <= 5; ++i)
+            try
             {
-                threads.emplace_back(init, i);
+                days[i].get();
             }
-
-            for (auto& t : threads) 
+            catch (const std::exception& e)
             {
-                if (t.joinable()) 
-                {
-                    t.join();
-                }
+                std::cerr << "ERROR: Day " << i + 1 << ": " << e.what() << '\n';
             }
         }
         